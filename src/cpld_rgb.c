@@ -132,6 +132,14 @@ static int RGB_CPLD_detected = 0;
 
 // invert state (not part of config)
 static int invert = 0;
+
+// The last sample point register contents and DAC settings sent, so write_config only
+// sends what has changed (calibration rewrites the whole config for every offset it
+// tries). Reset by cpld_init, as nothing has been sent to this CPLD yet.
+static int last_sp;
+static int last_scan_len;
+static int last_dac[8];
+
 // =============================================================
 // Param definitions for OSD
 // =============================================================
@@ -604,6 +612,22 @@ static int get_adjusted_divider_index() {
     return divider_index;
 }
 
+// Clocks one bit into the DAC on the analog board. The data changes with the clock enable
+// leaving latch_level, which then returns to it to latch the bit.
+static void send_dac_bit(int bit, int latch_level) {
+    uint32_t data = bit ? SP_DATA_MASK : 0;
+    if (latch_level) {
+        RPI_SetGpioMask(data, SP_CLKEN_MASK | (SP_DATA_MASK ^ data));
+        delay_in_arm_cycles_cpu_adjust(500);
+        RPI_SetGpioMask(SP_CLKEN_MASK, 0);
+    } else {
+        RPI_SetGpioMask(SP_CLKEN_MASK | data, SP_DATA_MASK ^ data);
+        delay_in_arm_cycles_cpu_adjust(500);
+        RPI_SetGpioMask(0, SP_CLKEN_MASK);
+    }
+    delay_in_arm_cycles_cpu_adjust(500);
+}
+
 static void sendDAC(int dac, int value)
 {
     if (value > 255) {
@@ -653,6 +677,12 @@ static void sendDAC(int dac, int value)
         default:
         break;
     }
+    // the DACs hold their settings, so only send one that has changed
+    int key = value | (old_value << 8) | (frontend << 16);
+    if (last_dac[dac] == key) {
+        return;
+    }
+    last_dac[dac] = key;
     if (frontend == FRONTEND_ANALOG_ISSUE2_5259) {
         switch (dac) {
             case 6:
@@ -679,11 +709,7 @@ static void sendDAC(int dac, int value)
                 //log_info("M62364 dac:%d = %02X, %03X", dac, value, packet);
                 RPI_SetGpioValue(STROBE_PIN, 0);
                 for (int i = 0; i < 12; i++) {
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-                    RPI_SetGpioValue(SP_DATA_PIN, (packet >> 11) & 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
+                    send_dac_bit((packet >> 11) & 1, 1);
                     packet <<= 1;
                 }
                 RPI_SetGpioValue(STROBE_PIN, 1);
@@ -693,11 +719,7 @@ static void sendDAC(int dac, int value)
                 RPI_SetGpioValue(STROBE_PIN, 0);
 
                 for (int i = 0; i < 14; i++) {
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-                    RPI_SetGpioValue(SP_DATA_PIN, packet & 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
+                    send_dac_bit(packet & 1, 1);
                     packet >>= 1;
                 }
                 RPI_SetGpioValue(STROBE_PIN, 1);
@@ -708,11 +730,7 @@ static void sendDAC(int dac, int value)
                 int packet = (dac << 11) | 0x600 | value;
                 RPI_SetGpioValue(STROBE_PIN, 0);
                 for (int i = 0; i < 16; i++) {
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-                    RPI_SetGpioValue(SP_DATA_PIN, (packet >> 15) & 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
+                    send_dac_bit((packet >> 15) & 1, 1);
                     packet <<= 1;
                 }
                 RPI_SetGpioValue(STROBE_PIN, 1);
@@ -730,11 +748,7 @@ static void sendDAC(int dac, int value)
                 RPI_SetGpioValue(STROBE_PIN, 1);
                 delay_in_arm_cycles_cpu_adjust(1000);
                 for (int i = 0; i < 11; i++) {
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-                    RPI_SetGpioValue(SP_DATA_PIN, (packet >> 10) & 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-                    delay_in_arm_cycles_cpu_adjust(500);
+                    send_dac_bit((packet >> 10) & 1, 0);
                     packet <<= 1;
                 }
                 RPI_SetGpioValue(STROBE_PIN, 0);
@@ -754,11 +768,7 @@ static void sendDAC(int dac, int value)
                 delay_in_arm_cycles_cpu_adjust(500);
                 RPI_SetGpioValue(STROBE_PIN, 0);
                 for (int i = 0; i < 16; i++) {
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-                    RPI_SetGpioValue(SP_DATA_PIN, (packet >> 15) & 1);
-                    delay_in_arm_cycles_cpu_adjust(500);
-                    RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-                    delay_in_arm_cycles_cpu_adjust(500);
+                    send_dac_bit((packet >> 15) & 1, 0);
                     packet <<= 1;
                 }
                 RPI_SetGpioValue(SP_DATA_PIN, 0);
@@ -913,18 +923,23 @@ static void write_config(config_t *config, int dac_update) {
 
    //log_info("scan = %X, %d",sp, scan_len);
 
-   for (int i = 0; i < scan_len; i++) {
-      RPI_SetGpioValue(SP_DATA_PIN, sp & 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLK_PIN, 0);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLK_PIN, 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-      delay_in_arm_cycles_cpu_adjust(250);
-      sp >>= 1;
+   // The register is a plain shift chain, so it can't be partly rewritten, but there is
+   // no need to shift it out again if nothing in it has changed
+   if (sp != last_sp || scan_len != last_scan_len) {
+      last_sp = sp;
+      last_scan_len = scan_len;
+      for (int i = 0; i < scan_len; i++) {
+         uint32_t data = (sp & 1) ? SP_DATA_MASK : 0;
+         RPI_SetGpioMask(SP_CLKEN_MASK | data, SP_DATA_MASK ^ data);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLK_PIN, 0);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLK_PIN, 1);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLKEN_PIN, 0);
+         delay_in_arm_cycles_cpu_adjust(250);
+         sp >>= 1;
+      }
    }
 
    if (supports_analog) {
@@ -1171,6 +1186,11 @@ static void cpld_init(int version) {
    }
 
    cpld_version = version;
+   last_sp = -1;
+   last_scan_len = -1;
+   for (int i = 0; i < 8; i++) {
+      last_dac[i] = -1;
+   }
    // Setup default frame buffer params
    //
    // Nominal width should be 640x512 or 480x504, but making this a bit larger deals with two problems:
@@ -1803,13 +1823,80 @@ static void cpld_set_value(int num, int value) {
 }
 
 
+// Measures the error metrics at count offset values from first (wrapping round), skipping
+// any already measured in this pass, and returns their total
+static int measure_offsets(capture_info_t *capinfo, int elk, int first, int count, int range, int offset_range, int (*raw_metrics)[16][NUM_OFFSETS], int (*sum_metrics)[16]) {
+   int total = 0;
+   char msg[256];
+   for (int n = 0; n < count; n++) {
+      int value = (first + n + range) % range;
+      if ((*sum_metrics)[value] < 0) {
+         for (int i = 0; i < NUM_OFFSETS; i++) {
+            config->sp_offset[i] = value;
+         }
+         config->all_offsets = config->sp_offset[0] + offset_range;
+         write_config(config, DAC_UPDATE);
+         int *by_sample_metrics = diff_N_frames_by_sample(capinfo, NUM_CAL_FRAMES, elk);
+         int metric = 0;
+         int msgptr = 0;
+         msgptr += sprintf(msg + msgptr, "INFO: value = %d: metrics = ", value + offset_range);
+         for (int i = 0; i < NUM_OFFSETS; i++) {
+            (*raw_metrics)[value][i] = by_sample_metrics[i];
+            metric += by_sample_metrics[i];
+            msgptr += sprintf(msg + msgptr, "%7d", by_sample_metrics[i]);
+         }
+         msgptr += sprintf(msg + msgptr, "%8d", metric);
+         log_info(msg);
+         (*sum_metrics)[value] = metric;
+         osd_sp(config, 2, metric, -1);
+         if (capinfo->bpp == 16) {
+            unsigned int flags = extra_flags() | BIT_CALIBRATE | (2 << OFFSET_NBUFFERS);
+
+            rgb_to_fb(capinfo, flags);  //restore OSD
+            delay_in_arm_cycles_cpu_adjust(1000000000);
+         }
+      }
+      total += (*sum_metrics)[value];
+   }
+   return total;
+}
+
+// The first of the noisiest offsets measured, unmeasured ones are -1
+static int noisiest_offset(int *sum_metrics, int range) {
+   int max_metric = 0;
+   int max_i = 0;
+   for (int i = 0; i < range; i++) {
+      if (sum_metrics[i] > max_metric) {
+         max_metric = sum_metrics[i];
+         max_i = i;
+      }
+   }
+   return max_i;
+}
+
+// Total of the metrics from left below i to right above it, INT_MAX if any weren't measured
+static int window_metric(int *sum_metrics, int i, int left, int right, int range) {
+   int total = 0;
+   for (int j = i - left; j <= i + right; j++) {
+      int metric = sum_metrics[(j + range) % range];
+      if (metric < 0) {
+         return INT_MAX;
+      }
+      total += metric;
+   }
+   return total;
+}
+
+// Is there a window of two or three offsets including i with no errors
+static int zero_window(int *sum_metrics, int i, int range) {
+   return window_metric(sum_metrics, i, 1, 0, range) == 0 || window_metric(sum_metrics, i, 0, 1, range) == 0;
+}
+
 static void cpld_calibrate_sub(capture_info_t *capinfo, int elk, int (*raw_metrics)[16][NUM_OFFSETS], int (*sum_metrics)[16], int *errors, int *window_errors) {
    int min_i = 0;
-   int metric;         // this is a point value (at one sample offset)
    int min_metric;
    int win_metric;     // this is a windowed value (over three sample offsets)
    int min_win_metric;
-   int *by_sample_metrics;
    int range;          // 0..5 in Modes 0..6, 0..7 in Mode 7
    int oddeven = 0;
    int offset_range = 0;
@@ -1823,7 +1910,6 @@ static void cpld_calibrate_sub(capture_info_t *capinfo, int elk, int (*raw_metri
        offset_range = config->all_offsets >= range ? range : 0;
    }
 
-   // Measure the error metrics at all possible offset values
    min_metric = INT_MAX;
    if (!oddeven) {  // if mode 7 cpld using odd/even then let caller set config->half_px_delay as it is actually a quarter pixel delay
       config->half_px_delay = 0;
@@ -1844,67 +1930,79 @@ static void cpld_calibrate_sub(capture_info_t *capinfo, int elk, int (*raw_metri
    }
    sprintf(msg + msgptr, "   total");
    log_info(msg);
-   for (int value = 0; value < range; value++) {
+   for (int value = 0; value < 16; value++) {
+      (*sum_metrics)[value] = -1;
       for (int i = 0; i < NUM_OFFSETS; i++) {
-         config->sp_offset[i] = value;
+         (*raw_metrics)[value][i] = -1;
       }
-      config->all_offsets = config->sp_offset[0] + offset_range;
-      write_config(config, DAC_UPDATE);
-      by_sample_metrics = diff_N_frames_by_sample(capinfo, NUM_CAL_FRAMES, elk);
-      metric = 0;
-      msgptr = 0;
-      msgptr += sprintf(msg + msgptr, "INFO: value = %d: metrics = ", value + offset_range);
-      for (int i = 0; i < NUM_OFFSETS; i++) {
-         (*raw_metrics)[value][i] = by_sample_metrics[i];
-         metric += by_sample_metrics[i];
-         msgptr += sprintf(msg + msgptr, "%7d", by_sample_metrics[i]);
+   }
+
+   // With enough offsets to make it worthwhile, measure every other one, fill in either
+   // side of the noisiest and then only the window the choice below would be made from.
+   // If that has no errors the choice is made from it and the noisiest offset the search
+   // found, otherwise the rest are measured and the choice is made from the full sweep.
+   // When the coarse pass is all zero (a clean source) the noisiest stays at 0, as it
+   // would after a full sweep, so only the odd offsets either side of the chosen one are
+   // measured.
+   int found = 0;
+   int max_i = 0;
+   if (range >= 6) {
+      for (int value = 0; value < range; value += 2) {
+         measure_offsets(capinfo, elk, value, 1, range, offset_range, raw_metrics, sum_metrics);
       }
-      msgptr += sprintf(msg + msgptr, "%8d", metric);
-      log_info(msg);
-      (*sum_metrics)[value] = metric;
-      osd_sp(config, 2, metric, -1);
-      if (capinfo->bpp == 16) {
-         unsigned int flags = extra_flags() | BIT_CALIBRATE | (2 << OFFSET_NBUFFERS);
-
-         rgb_to_fb(capinfo, flags);  //restore OSD
-         delay_in_arm_cycles_cpu_adjust(1000000000);
+      max_i = noisiest_offset(*sum_metrics, range);
+      if ((*sum_metrics)[max_i] > 0) {
+         measure_offsets(capinfo, elk, max_i - 1, 3, range, offset_range, raw_metrics, sum_metrics);
+         max_i = noisiest_offset(*sum_metrics, range);
       }
-      if (metric < min_metric) {
-         min_metric = metric;
+      if (config->range == RANGE_180 || capinfo->mode7) {
+         found = measure_offsets(capinfo, elk, max_i + (range >> 1) - 1, 3, range, offset_range, raw_metrics, sum_metrics) == 0;
+      } else {
+         int min_i_90 = (max_i + (range >> 2)) % range;
+         int min_i_270 = (max_i + (range >> 1) + (range >> 2)) % range;
+         // a three offset window at 90 is chosen before anything at 270
+         if (measure_offsets(capinfo, elk, min_i_90 - 1, 3, range, offset_range, raw_metrics, sum_metrics) != 0) {
+            measure_offsets(capinfo, elk, min_i_270 - 1, 3, range, offset_range, raw_metrics, sum_metrics);
+         }
+         found = zero_window(*sum_metrics, min_i_90, range) || zero_window(*sum_metrics, min_i_270, range);
       }
    }
+   if (!found) {
+      measure_offsets(capinfo, elk, 0, range, range, offset_range, raw_metrics, sum_metrics);
+   }
+   int measured = 0;
+   for (int value = 0; value < range; value++) {
+      if ((*sum_metrics)[value] >= 0) {
+         measured++;
+         if ((*sum_metrics)[value] < min_metric) {
+            min_metric = (*sum_metrics)[value];
+         }
+      }
+   }
+   log_info("Measured %d of %d sample offsets", measured, range);
 
    min_win_metric = INT_MAX;
-   //first seatch for noisiest sample phase
-   int max_metric = 0;
-   int max_i = 0;
-   for (int i = 0; i < range; i++) {
-      if ((*sum_metrics)[i] > max_metric) {
-         max_metric = (*sum_metrics)[i];
-         max_i = i;
-      }
+   //first seatch for noisiest sample phase, after a search that found its window keep the one it was found from
+   if (!found) {
+       max_i = noisiest_offset(*sum_metrics, range);
    }
    if (config->range == RANGE_180 || capinfo->mode7) {  // always use 180 degrees in mode 7 as no option to switch to 90
        min_i = (max_i + (range >> 1)) % range;   //180 degrees from worst
-       min_win_metric = (*sum_metrics)[(min_i - 1 + range) % range] + (*sum_metrics)[min_i] + (*sum_metrics)[(min_i + 1 + range) % range]; // is this a good sample point?
+       min_win_metric = window_metric(*sum_metrics, min_i, 1, 1, range); // is this a good sample point?
    } else {
        int min_i_90 = (max_i + (range >> 2)) % range;                   //90 degrees from worst
-       int min_win_metric_90_left = (*sum_metrics)[(min_i_90 - 1 + range) % range] + (*sum_metrics)[min_i_90];
-       int min_win_metric_90_right = (*sum_metrics)[min_i_90] + (*sum_metrics)[(min_i_90 + 1 + range) % range];
        int min_i_270 = (max_i + (range >> 1) + (range >> 2)) % range;   //270 degrees from worst
-       int min_win_metric_270_left = (*sum_metrics)[(min_i_270 - 1 + range) % range] + (*sum_metrics)[min_i_270];
-       int min_win_metric_270_right = (*sum_metrics)[min_i_270] + (*sum_metrics)[(min_i_270 + 1 + range) % range];
 
-       if ((min_win_metric_90_left + min_win_metric_90_right) == 0) {              // is there a good 3 sample phase window at 90?
+       if (window_metric(*sum_metrics, min_i_90, 1, 1, range) == 0) {             // is there a good 3 sample phase window at 90?
            min_i = min_i_90;
            min_win_metric = 0;
-       }else if ((min_win_metric_270_left + min_win_metric_270_right) == 0) {      // is there a good 3 sample phase window at 270?
+       } else if (window_metric(*sum_metrics, min_i_270, 1, 1, range) == 0) {     // is there a good 3 sample phase window at 270?
            min_i = min_i_270;
            min_win_metric = 0;
-       } else if (min_win_metric_90_left == 0 || min_win_metric_90_right == 0) {   // is there a good 2 sample phase window at 90?
+       } else if (zero_window(*sum_metrics, min_i_90, range)) {                   // is there a good 2 sample phase window at 90?
            min_i = min_i_90;
            min_win_metric = 0;
-       } else if (min_win_metric_270_left == 0 || min_win_metric_270_right == 0) { // is there a good 2 sample phase window at 270?
+       } else if (zero_window(*sum_metrics, min_i_270, range)) {                  // is there a good 2 sample phase window at 270?
            min_i = min_i_270;
            min_win_metric = 0;
        }
@@ -1914,9 +2012,7 @@ static void cpld_calibrate_sub(capture_info_t *capinfo, int elk, int (*raw_metri
    // Use a 3 sample window to find the minimum and maximum
        min_win_metric = INT_MAX;
        for (int i = 0; i < range; i++) {
-          int left  = (i - 1 + range) % range;
-          int right = (i + 1 + range) % range;
-          win_metric = (*sum_metrics)[left] + (*sum_metrics)[i] + (*sum_metrics)[right];
+          win_metric = window_metric(*sum_metrics, i, 1, 1, range);
           if ((*sum_metrics)[i] == min_metric) {
              if (win_metric < min_win_metric) {
                 min_win_metric = win_metric;
@@ -2123,7 +2219,11 @@ static void cpld_show_cal_details(int line) {
           offset_range = config->all_offsets >= range ? range : 0;
       }
       for (int value = 0; value < range; value++) {
-         sprintf(message, "Phase %2d: Errors = %6d", value + offset_range, sum_metrics[value]);
+         if (sum_metrics[value] < 0) {
+            sprintf(message, "Phase %2d: Not measured", value + offset_range);
+         } else {
+            sprintf(message, "Phase %2d: Errors = %6d", value + offset_range, sum_metrics[value]);
+         }
          osd_set(line + value, 0, message);
       }
    }
@@ -2144,8 +2244,12 @@ static void cpld_show_cal_raw(int line) {
       for (int value = 0; value < range; value++) {
          char *mp = message;
          mp += sprintf(mp, "%2d:", value + offset_range);
-         for (int i = 0; i < NUM_OFFSETS; i++) {
-            mp += sprintf(mp, "%6d", (*raw_metrics)[value][i]);
+         if ((*raw_metrics)[value][0] < 0) {
+            sprintf(mp, " Not measured");
+         } else {
+            for (int i = 0; i < NUM_OFFSETS; i++) {
+               mp += sprintf(mp, "%6d", (*raw_metrics)[value][i]);
+            }
          }
          osd_set(line + value, 0, message);
       }
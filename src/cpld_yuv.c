@@ -355,6 +355,14 @@ static int supports_mux            = 1; /* mux moved from pin to register bit */
 
 // invert state (not part of config)
 static int invert = 0;
+
+// The last sample point register contents and DAC settings sent, so write_config only
+// sends what has changed (calibration rewrites the whole config for every offset it
+// tries). Reset by cpld_init, as nothing has been sent to this CPLD yet.
+static int last_sp;
+static int last_scan_len;
+static int last_dac[8];
+
 static int supports_analog = 0;
 
 static int modeset = 0;
@@ -530,6 +538,22 @@ static int getRange() {
    }
 }
 
+// Clocks one bit into the DAC on the analog board. The data changes with the clock enable
+// leaving latch_level, which then returns to it to latch the bit.
+static void send_dac_bit(int bit, int latch_level) {
+    uint32_t data = bit ? SP_DATA_MASK : 0;
+    if (latch_level) {
+        RPI_SetGpioMask(data, SP_CLKEN_MASK | (SP_DATA_MASK ^ data));
+        delay_in_arm_cycles_cpu_adjust(500);
+        RPI_SetGpioMask(SP_CLKEN_MASK, 0);
+    } else {
+        RPI_SetGpioMask(SP_CLKEN_MASK | data, SP_DATA_MASK ^ data);
+        delay_in_arm_cycles_cpu_adjust(500);
+        RPI_SetGpioMask(0, SP_CLKEN_MASK);
+    }
+    delay_in_arm_cycles_cpu_adjust(500);
+}
+
 static void sendDAC(int dac, int value)
 {
     if (value > 255) {
@@ -581,16 +605,19 @@ static void sendDAC(int dac, int value)
         break;
     }
 
+    // the DACs hold their settings, so only send one that has changed
+    int key = value | (frontend << 8);
+    if (last_dac[dac] == key) {
+        return;
+    }
+    last_dac[dac] = key;
+
     if (new_DAC_detected() == 1) {
         int packet = (M62364_dac << 8) | value;
         //log_info("M62364 dac:%d = %02X, %03X", dac, value, packet);
         RPI_SetGpioValue(STROBE_PIN, 0);
         for (int i = 0; i < 12; i++) {
-            RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-            RPI_SetGpioValue(SP_DATA_PIN, (packet >> 11) & 1);
-            delay_in_arm_cycles_cpu_adjust(500);
-            RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-            delay_in_arm_cycles_cpu_adjust(500);
+            send_dac_bit((packet >> 11) & 1, 1);
             packet <<= 1;
         }
         RPI_SetGpioValue(STROBE_PIN, 1);
@@ -600,11 +627,7 @@ static void sendDAC(int dac, int value)
         RPI_SetGpioValue(STROBE_PIN, 0);
 
         for (int i = 0; i < 14; i++) {
-            RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-            RPI_SetGpioValue(SP_DATA_PIN, packet & 1);
-            delay_in_arm_cycles_cpu_adjust(500);
-            RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-            delay_in_arm_cycles_cpu_adjust(500);
+            send_dac_bit(packet & 1, 1);
             packet >>= 1;
         }
         RPI_SetGpioValue(STROBE_PIN, 1);
@@ -615,11 +638,7 @@ static void sendDAC(int dac, int value)
         int packet = (dac << 11) | 0x600 | value;
         RPI_SetGpioValue(STROBE_PIN, 0);
         for (int i = 0; i < 16; i++) {
-            RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-            RPI_SetGpioValue(SP_DATA_PIN, (packet >> 15) & 1);
-            delay_in_arm_cycles_cpu_adjust(500);
-            RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-            delay_in_arm_cycles_cpu_adjust(500);
+            send_dac_bit((packet >> 15) & 1, 1);
             packet <<= 1;
         }
         RPI_SetGpioValue(STROBE_PIN, 1);
@@ -703,18 +722,23 @@ static void write_config(config_t *config, int dac_update) {
        scan_len += 1;
    }
 
-   for (int i = 0; i < scan_len; i++) {
-      RPI_SetGpioValue(SP_DATA_PIN, sp & 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLKEN_PIN, 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLK_PIN, 0);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLK_PIN, 1);
-      delay_in_arm_cycles_cpu_adjust(250);
-      RPI_SetGpioValue(SP_CLKEN_PIN, 0);
-      delay_in_arm_cycles_cpu_adjust(250);
-      sp >>= 1;
+   // The register is a plain shift chain, so it can't be partly rewritten, but there is
+   // no need to shift it out again if nothing in it has changed
+   if (sp != last_sp || scan_len != last_scan_len) {
+      last_sp = sp;
+      last_scan_len = scan_len;
+      for (int i = 0; i < scan_len; i++) {
+         uint32_t data = (sp & 1) ? SP_DATA_MASK : 0;
+         RPI_SetGpioMask(SP_CLKEN_MASK | data, SP_DATA_MASK ^ data);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLK_PIN, 0);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLK_PIN, 1);
+         delay_in_arm_cycles_cpu_adjust(250);
+         RPI_SetGpioValue(SP_CLKEN_PIN, 0);
+         delay_in_arm_cycles_cpu_adjust(250);
+         sp >>= 1;
+      }
    }
 
    if (dac_update) {
@@ -823,6 +847,11 @@ static void cpld_init(int version) {
    params[HALF].hidden = 1;
    params[DIVIDER].hidden = 1;
    cpld_version = version;
+   last_sp = -1;
+   last_scan_len = -1;
+   for (int i = 0; i < 8; i++) {
+      last_dac[i] = -1;
+   }
    config->all_offsets = 0;
    config->sp_offset[0] = 0;
    config->sp_offset[1] = 0;
@@ -26,6 +26,17 @@
 
 #define DONT_USE_MULTICORE_ON_PI2
 
+// #define INSTRUMENT_LINES          // record per line capture headroom for each capture_line kernel (see linetiming.c)
+
+#define RECORD_FIELDS 250            // fields written by Record Fields on the info menu (see recording.c)
+
+#define LINE_RING_SIZE 16            // line descriptors in flight between the capture core and the worker cores (power of 2)
+#define LINE_DESC_SIZE 16            // src, dst, flags, line number
+
+// #define USE_GPU_LINE_BUFFER       // GPU capture: the VPU writes each line to SDRAM instead of cycling the 6 mailbox registers
+
+#define GPU_LINE_BUFFER 0x08020000   // UNCACHED_MEM_BASE + 128K, 2049 words (4096 samples and a terminating word)
+
 // Define how the Pi Framebuffer is initialized
 // - if defined, use the property interface (Channel 8)
 // - if not defined, use to the the framebuffer interface (Channel 1)
@@ -290,6 +301,7 @@ typedef struct {
 #define VERSION_MASK  (1U << VERSION_PIN)
 #define STROBE_MASK   (1U << STROBE_PIN)
 #define SP_CLK_MASK   (1U << SP_CLK_PIN)
+#define SP_CLKEN_MASK (1U << SP_CLKEN_PIN)
 #define SP_DATA_MASK  (1U << SP_DATA_PIN)
 #define MUX_MASK      (1U << MUX_PIN)
 
@@ -514,6 +526,17 @@ typedef struct {
 #define SCALER_DISPLAY_LIST (volatile uint32_t *)(_get_peripheral_base() + 0x402000)
 #endif
 
+// Display list plane words used to find the scaler filter kernel
+#define SCALER_CTL0_SIZE_SHIFT 24    // bits 29..24, number of words in the plane
+#define SCALER_CTL0_UNITY      0x10  // no scaling, so no kernel
+#define SCALER_PPF_KERNEL_MASK 0x3fff
+#define SCALER_DISPLAY_LIST_WORDS 0x800   // 8K of display list memory
+
+// The polyphase filter kernel: 16 9 bit coefficients, three to a word, for half of a
+// symmetric 32 tap kernel (8 phases of 4 taps), stored mirrored in 11 words
+#define HVS_KERNEL_HALF_WORDS 6
+#define HVS_KERNEL_WORDS (HVS_KERNEL_HALF_WORDS * 2 - 1)
+
 #define PIXEL_FORMAT 1  // RGBA4444
 #ifdef RPI4
 #define PIXEL_ORDER 2   // ABGR in BCM2711
@@ -584,6 +607,7 @@ typedef struct {
 #define  SIMPLE_SYNC_FLAG  0x00008000
 #define  HIGH_LATENCY_FLAG 0x00004000
 #define  OLD_FIRMWARE_FLAG 0x00002000
+#define  LINE_TAG_FLAG     0x00001000
 
 #define  CPLD_NORMAL      0
 #define  CPLD_BLANK       1
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "defs.h"
+#include "logging.h"
+#include "rgb_to_fb.h"
+#include "rgb_to_hdmi.h"
+#include "startup.h"
+#include "deinterlace.h"
+
+// Each captured line is compared word by word with the copy of it kept from two fields
+// earlier. The line above it, from the previous field, is then replaced wherever either
+// of them changed when it was captured: by the average of the lines either side at 16bpp,
+// or by the line below at 8bpp where the words hold palette indices.
+//
+// Interlaced sources are captured at double height, so the fields land on alternate lines
+// and the capture loop hands each job the line just captured with the skipped line below
+// it as dst. Every line of the previous field is owned by the line below it, so the jobs
+// can run on any worker core in any order. They only read lines of the field being
+// captured, and finish long before the next field is drawn over the lines they write.
+
+static uint8_t *allocation = NULL;
+static unsigned int allocation_size = 0;
+static uint8_t *history;            // each line as it was last captured
+static uint8_t *motion;             // a flag per word, set if it changed when last captured
+static uint8_t *fb_base;
+static int fb_pitch;
+static int fb_height;
+static int fb_words;
+static int fb_bpp;
+static int running = 0;
+static volatile int worker_clear[4];   // set by each worker core as it runs worker_barrier
+
+static void deinterlace_line(line_desc_t *desc) {
+   // only woven interlaced fields, and not under the OSD which is redrawn every field
+   if ((desc->flags & (BIT_INTERLACED_VIDEO | BIT_OSD | BIT_PROBE | BIT_CALIBRATE)) != BIT_INTERLACED_VIDEO || desc->dst != desc->src + fb_pitch) {
+      return;
+   }
+   int offset = desc->src - fb_base;
+   if (offset < 2 * fb_pitch) {
+      return;
+   }
+   int row = offset / fb_pitch;
+   if (row >= fb_height) {
+      return;
+   }
+   uint32_t *line = (uint32_t *) desc->src;
+   uint32_t *missing = (uint32_t *) (desc->src - fb_pitch);
+   uint32_t *above = (uint32_t *) (desc->src - 2 * fb_pitch);
+   uint32_t *last = (uint32_t *) (history + row * fb_pitch);
+   uint8_t *moved = motion + row * fb_words;
+   uint8_t *missing_moved = moved - fb_words;
+
+   if (fb_bpp == 16) {
+      for (int i = 0; i < fb_words; i++) {
+         uint32_t word = line[i];
+         int changed = word != last[i];
+         if (changed || missing_moved[i]) {
+            // average each 4 bit component of both pixels
+            uint32_t a = above[i];
+            missing[i] = (a & word) + (((a ^ word) & 0xeeeeeeee) >> 1);
+         }
+         last[i] = word;
+         moved[i] = changed;
+      }
+   } else {
+      for (int i = 0; i < fb_words; i++) {
+         uint32_t word = line[i];
+         int changed = word != last[i];
+         if (changed || missing_moved[i]) {
+            missing[i] = word;
+         }
+         last[i] = word;
+         moved[i] = changed;
+      }
+   }
+}
+
+static void worker_barrier(int arg0, int arg1, int arg2, int arg3) {
+   // posted jobs are only taken between line jobs, so this core has finished its last line
+   worker_clear[_get_core()] = 1;
+}
+
+// Waits until every worker core has finished any line job it had already started
+static void wait_for_line_jobs() {
+   int pending = cores_available & ~1;
+   for (int core = 0; core < 4; core++) {
+      worker_clear[core] = 0;
+   }
+   __data_memory_barrier();
+   while (pending) {
+      post_core_job(worker_barrier, 0, 0, 0, 0);
+      for (int core = 1; core < 4; core++) {
+         if (worker_clear[core]) {
+            pending &= ~(1 << core);
+         }
+      }
+   }
+   __data_memory_barrier();
+}
+
+int deinterlace_start(capture_info_t *capinfo) {
+   if (get_worker_cores() == 0 || (capinfo->bpp != 8 && capinfo->bpp != 16)) {
+      deinterlace_stop();
+      return 0;
+   }
+   int words = (capinfo->width * capinfo->bpp) >> 5;
+   if (running && fb_base == capinfo->fb && fb_pitch == capinfo->pitch && fb_height == capinfo->height && fb_words == words && fb_bpp == capinfo->bpp) {
+      return 1;
+   }
+   deinterlace_stop();
+
+   unsigned int history_size = capinfo->pitch * capinfo->height;
+   unsigned int size = history_size + words * capinfo->height;
+   if (size > allocation_size) {
+      free(allocation);
+      allocation = malloc(size);
+      allocation_size = allocation ? size : 0;
+      if (!allocation) {
+         log_warn("No memory for motion adaptive deinterlace");
+         return 0;
+      }
+   }
+   history = allocation;
+   motion = allocation + history_size;
+   memset(history, 0, history_size);
+   memset(motion, 1, words * capinfo->height);     // bob until there is a field to compare with
+
+   fb_base = capinfo->fb;
+   fb_pitch = capinfo->pitch;
+   fb_height = capinfo->height;
+   fb_words = words;
+   fb_bpp = capinfo->bpp;
+   __data_memory_barrier();
+   line_job_function = deinterlace_line;
+   running = 1;
+   log_info("Motion adaptive deinterlace: %d lines of %d words at %dbpp", fb_height, fb_words, fb_bpp);
+   return 1;
+}
+
+void deinterlace_stop() {
+   if (running) {
+      line_job_function = NULL;
+      __data_memory_barrier();
+      // lines still in the ring are dropped, but a worker may be part way through one
+      wait_for_line_jobs();
+      running = 0;
+   }
+}
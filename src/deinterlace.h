@@ -0,0 +1,20 @@
+// deinterlace.h
+
+#ifndef DEINTERLACE_H
+#define DEINTERLACE_H
+
+#include "defs.h"
+
+// Motion adaptive deinterlace for the 8bpp and 16bpp capture paths. The fields are
+// captured woven and each line is handed to a worker core, which compares it with the
+// same line two fields earlier and fills in the line above it (from the previous field)
+// wherever the picture has moved, leaving still areas at full vertical resolution.
+
+// Sets up for the current frame buffer and installs the line job, returns 0 if it can't
+// run (no worker cores, unsuitable depth or no memory) and the caller should bob instead
+int deinterlace_start(capture_info_t *capinfo);
+
+// Removes the line job, the frame buffer is left as it is
+void deinterlace_stop();
+
+#endif
@@ -78,6 +78,9 @@ struct emmc_block_dev
 size_t block_read(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_t starting_block);
 size_t block_write(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_t starting_block);
 
+// Claims a DMA channel for card transfers, until then (or without one) they are PIO
+void sd_dma_init(void);
+
 #endif
 
 //#include "fs.h"
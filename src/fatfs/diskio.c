@@ -18,15 +18,64 @@
 #include "mmc_avr.h" /* Header file of existing SD control module */
 #endif
 
+#include <string.h>
+
 #ifdef DRV_SD
 #include "block.h"
 size_t sd_read(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_t block_no);
 size_t sd_write(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_t block_no);
+uint32_t sd_take_suppressed_messages(void);
 #endif
 
 //static unsigned int sd_status=STA_NOINIT;
 
 static struct emmc_block_dev bd;
+
+/*-----------------------------------------------------------------------*/
+/* Sector cache                                                          */
+/*-----------------------------------------------------------------------*/
+/* A small direct mapped, write through cache of the sectors FatFs reads */
+/* a few at a time (FAT, directories and short files such as profiles),  */
+/* so with the volume kept mounted repeated lookups don't go to the card.*/
+/* Longer reads are file data and bypass it. Being write through it      */
+/* never holds anything the card doesn't, so there is nothing to flush.  */
+
+#define CACHE_SECTORS   128   /* must be a power of 2 */
+#define CACHE_MAX_READ  8     /* reads longer than this aren't cached */
+
+static DWORD cache_tag[CACHE_SECTORS];
+static BYTE cache_valid[CACHE_SECTORS];
+static BYTE cache_data[CACHE_SECTORS][512] __attribute__((aligned(4)));
+
+static int cache_find (DWORD sector)
+{
+   int i = sector & (CACHE_SECTORS - 1);
+   return (cache_valid[i] && cache_tag[i] == sector) ? i : -1;
+}
+
+static void cache_store (DWORD sector, const BYTE *buff)
+{
+   int i = sector & (CACHE_SECTORS - 1);
+   memcpy(cache_data[i], buff, 512);
+   cache_tag[i] = sector;
+   cache_valid[i] = 1;
+}
+
+void disk_cache_invalidate (void)
+{
+   memset(cache_valid, 0, sizeof(cache_valid));
+}
+
+/* Number of card driver messages dropped because they came from a worker */
+/* core, since the last call                                             */
+UINT disk_take_suppressed_messages (void)
+{
+#ifdef DRV_SD
+   return sd_take_suppressed_messages();
+#else
+   return 0;
+#endif
+}
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -93,7 +142,27 @@ DRESULT disk_read (
 #endif
 #ifdef DRV_SD
    case DRV_SD :
-      return sd_read((struct block_device *)&bd,buff,512*count,sector)?RES_OK:RES_ERROR;
+   {
+      UINT i;
+      if (count <= CACHE_MAX_READ) {
+         for (i = 0; i < count && cache_find(sector + i) >= 0; i++);
+         if (i == count) {
+            for (i = 0; i < count; i++) {
+               memcpy(buff + 512 * i, cache_data[cache_find(sector + i)], 512);
+            }
+            return RES_OK;
+         }
+      }
+      if (!sd_read((struct block_device *)&bd,buff,512*count,sector)) {
+         return RES_ERROR;
+      }
+      if (count <= CACHE_MAX_READ) {
+         for (i = 0; i < count; i++) {
+            cache_store(sector + i, buff + 512 * i);
+         }
+      }
+      return RES_OK;
+   }
 #endif
    }
    return RES_PARERR;
@@ -120,7 +189,21 @@ DRESULT disk_write (
 #endif
 #ifdef DRV_SD
    case DRV_SD :
-      return sd_write((struct block_device *)&bd,buff,512*count,sector)?RES_OK:RES_ERROR;
+   {
+      UINT i;
+      int ok = sd_write((struct block_device *)&bd,buff,512*count,sector);
+      for (i = 0; i < count; i++) {
+         int c = cache_find(sector + i);
+         if (!ok) {
+            if (c >= 0) {
+               cache_valid[c] = 0;   /* what the card holds now is unknown */
+            }
+         } else if (c >= 0 || count == 1) {
+            cache_store(sector + i, buff + 512 * i);
+         }
+      }
+      return ok?RES_OK:RES_ERROR;
+   }
 #endif
    }
    return RES_PARERR;
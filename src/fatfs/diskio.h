@@ -46,6 +46,8 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 void disk_timerproc (void);
+void disk_cache_invalidate (void);
+UINT disk_take_suppressed_messages (void);
 
 
 /* Disk Status Bits (DSTATUS) */
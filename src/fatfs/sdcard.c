@@ -39,6 +39,7 @@
 
 #include "../rpi-systimer.h"
 #include "../rpi-base.h"
+#include "../rpi-dma.h"
 #include "../startup.h"
 
 #define TIMEOUT_WAIT(stop_if_true, usec)     \
@@ -55,6 +56,20 @@
 #endif
 extern void  _data_memory_barrier();
 
+// disk_read and disk_write are also called on a worker core (screenshots, the log and
+// recordings), where printing would interleave with core 0 on the UART. So off core 0
+// messages are only counted, for core 0 to report (sd_take_suppressed_messages), and
+// the failures themselves come back as the usual error returns.
+static volatile uint32_t sd_suppressed_messages = 0;
+#define printf(...) do { if (_get_core() == 0) { printf(__VA_ARGS__); } else { sd_suppressed_messages++; } } while (0)
+
+uint32_t sd_take_suppressed_messages(void)
+{
+   uint32_t count = sd_suppressed_messages;
+   sd_suppressed_messages -= count;
+   return count;
+}
+
 uintptr_t base_adjust =0;
 
 inline void mmio_write(uintptr_t reg, uint32_t data)
@@ -90,12 +105,20 @@ inline uint32_t mmio_read(uintptr_t reg)
 // Requires 150 mA power so disabled on the RPi for now
 //#define SDXC_MAXIMUM_PERFORMANCE
 
-// Enable SDMA support
-//#define SDMA_SUPPORT
-
-// SDMA buffer address
-#define SDMA_BUFFER     0x6000
-#define SDMA_BUFFER_PA  (SDMA_BUFFER + 0xC0000000UL)
+// Enable DMA support
+// The controller's own SDMA engine isn't usable on the BCM283x, so data is moved
+// between the EMMC data port and a bounce buffer by a system DMA channel paced by
+// the EMMC DREQ. The bounce buffer is in uncached memory (after the frame buffer
+// DMA control block, see rpi-dma.c) so it needs no cache maintenance, and each
+// run of up to SD_DMA_BUFFER_SIZE bytes is a single CMD18/CMD25.
+#define SD_DMA_SUPPORT
+
+#define SD_DMA_BUFFER       0x08040000   // UNCACHED_MEM_BASE + 256K
+#define SD_DMA_BUFFER_SIZE  0x20000      // 128K, 256 blocks
+#define SD_DMA_CB           (SD_DMA_BUFFER + SD_DMA_BUFFER_SIZE)
+#define SD_DMA_BUS(x)       ((((uint32_t) (x)) & 0x3fffffff) | 0xC0000000)
+#define SD_DMA_DATA_PORT    (0x7E000000 + EMMC_BASE + EMMC_DATA)
+#define SD_DMA_DREQ         11
 
 // Enable card interrupts
 //#define SD_CARD_INTERRUPTS
@@ -681,6 +704,62 @@ static int sd_reset_dat()
    return 0;
 }
 
+#ifdef SD_DMA_SUPPORT
+static rpi_dma_channel_t *sd_dma_channel = 0;
+
+void sd_dma_init(void)
+{
+    if(!sd_dma_channel)
+        sd_dma_channel = RPI_DMA_Claim();
+}
+
+// Moves blocks_to_transfer blocks between the data port and the bounce buffer
+static void sd_dma_start(struct emmc_block_dev *dev, int is_read)
+{
+    rpi_dma_cb_t *cb = (rpi_dma_cb_t *)SD_DMA_CB;
+    if(is_read)
+    {
+        cb->ti = DMA_TI_SRC_DREQ | DMA_TI_PERMAP(SD_DMA_DREQ) | DMA_TI_DEST_INC | DMA_TI_WAIT_RESP;
+        cb->source_ad = SD_DMA_DATA_PORT;
+        cb->dest_ad = SD_DMA_BUS(SD_DMA_BUFFER);
+    }
+    else
+    {
+        cb->ti = DMA_TI_DEST_DREQ | DMA_TI_PERMAP(SD_DMA_DREQ) | DMA_TI_SRC_INC | DMA_TI_WAIT_RESP;
+        cb->source_ad = SD_DMA_BUS(SD_DMA_BUFFER);
+        cb->dest_ad = SD_DMA_DATA_PORT;
+    }
+    cb->txfr_len = dev->blocks_to_transfer * dev->block_size;
+    cb->stride = 0;
+    cb->nextconbk = 0;
+    _data_memory_barrier();
+    sd_dma_channel->cs = DMA_CS_END | DMA_CS_INT;
+    sd_dma_channel->conblk_ad = SD_DMA_BUS(cb);
+    sd_dma_channel->cs = DMA_CS_ACTIVE | DMA_CS_PRIORITY(8) | DMA_CS_PANIC_PRIORITY(8) | DMA_CS_WAIT_FOR_OUTSTANDING_WRITES;
+}
+
+// Waits for the last words to land after a successful command, or stops the channel
+// after a failed one, returns 0 if the transfer didn't complete
+static int sd_dma_finish(struct emmc_block_dev *dev)
+{
+    int ok = SUCCESS(dev);
+    if(ok)
+    {
+        TIMEOUT_WAIT(!(sd_dma_channel->cs & DMA_CS_ACTIVE), 100000);
+        ok = !(sd_dma_channel->cs & (DMA_CS_ACTIVE | DMA_CS_ERROR));
+    }
+    if(!ok)
+    {
+        sd_dma_channel->cs = DMA_CS_RESET;
+        while(sd_dma_channel->cs & DMA_CS_RESET);
+    }
+    // The DMA channel answered the buffer read/write ready interrupts, clear them so
+    //  a later PIO transfer doesn't see them
+    mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT, 0x30);
+    return ok;
+}
+#endif
+
 static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, uint32_t argument, useconds_t timeout)
 {
     dev->last_cmd_reg = cmd_reg;
@@ -709,28 +788,17 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, u
     }
 
     // Is this a DMA transfer?
-    int is_sdma = 0;
+    int is_dma = 0;
     if((cmd_reg & SD_CMD_ISDATA) && (dev->use_sdma))
     {
 #ifdef EMMC_DEBUG
-        printf("SD: performing SDMA transfer, current INTERRUPT: %08"PRIx32"\r\n",
+        printf("SD: performing DMA transfer, current INTERRUPT: %08"PRIx32"\r\n",
                mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT));
 #endif
-        is_sdma = 1;
-    }
-
-    if(is_sdma)
-    {
-        // Set system address register (ARGUMENT2 in RPi)
-
-        // We need to define a 4 kiB aligned buffer to use here
-        // Then convert its virtual address to a bus address
-        mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_ARG2, SDMA_BUFFER_PA);
+        is_dma = 1;
     }
 
     // Set block size and block count
-    // For now, block size = 512 bytes, block count = 1,
-    //  host SDMA buffer boundary = 4 kiB
     if(dev->blocks_to_transfer > 0xffff)
     {
         printf("SD: blocks_to_transfer too great (%i)\r\n",
@@ -744,10 +812,10 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, u
     // Set argument 1 reg
     mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_ARG1, argument);
 
-    if(is_sdma)
+    if(is_dma)
     {
-        // Set Transfer mode register
-        cmd_reg |= SD_CMD_DMA;
+        // The channel waits on the DREQ, so it can be started before the command
+        sd_dma_start(dev, cmd_reg & SD_CMD_DAT_DIR_CH);
     }
 
     // Set command reg
@@ -792,7 +860,7 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, u
     }
 
     // If with data, wait for the appropriate interrupt
-    if((cmd_reg & SD_CMD_ISDATA) && (is_sdma == 0))
+    if((cmd_reg & SD_CMD_ISDATA) && (is_dma == 0))
     {
         uint32_t wr_irpt;
         int is_write = 0;
@@ -855,9 +923,10 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, u
         }
     }
 
-    // Wait for transfer complete (set if read/write transfer or with busy)
-    if((((cmd_reg & SD_CMD_RSPNS_TYPE_MASK) == SD_CMD_RSPNS_TYPE_48B) ||
-       (cmd_reg & SD_CMD_ISDATA)) && (is_sdma == 0))
+    // Wait for transfer complete (set if read/write transfer or with busy),
+    //  for a DMA transfer the channel has emptied or filled the FIFO by then
+    if(((cmd_reg & SD_CMD_RSPNS_TYPE_MASK) == SD_CMD_RSPNS_TYPE_48B) ||
+       (cmd_reg & SD_CMD_ISDATA))
     {
         // First check command inhibit (DAT) is not already 0
         if((mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_STATUS) & 0x2) == 0)
@@ -882,86 +951,6 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg, u
             mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT, 0xffff0002);
         }
     }
-    else if (is_sdma)
-    {
-        // For SDMA transfers, we have to wait for either transfer complete,
-        //  DMA int or an error
-
-        // First check command inhibit (DAT) is not already 0
-        if((mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_STATUS) & 0x2) == 0)
-            mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT, 0xffff000a);
-        else
-        {
-            TIMEOUT_WAIT(mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT) & 0x800a, timeout);
-            irpts = mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT);
-            mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_INTERRUPT, 0xffff000a);
-
-            // Detect errors
-            if((irpts & 0x8000) && ((irpts & 0x2) != 0x2))
-            {
-#ifdef EMMC_DEBUG
-                printf("SD: error occured whilst waiting for transfer complete interrupt\r\n");
-#endif
-                dev->last_error = irpts & 0xffff0000;
-                dev->last_interrupt = irpts;
-                return;
-            }
-
-            // Detect DMA interrupt without transfer complete
-            // Currently not supported - all block sizes should fit in the
-            //  buffer
-            if((irpts & 0x8) && ((irpts & 0x2) != 0x2))
-            {
-#ifdef EMMC_DEBUG
-                printf("SD: error: DMA interrupt occured without transfer complete\r\n");
-#endif
-                dev->last_error = irpts & 0xffff0000;
-                dev->last_interrupt = irpts;
-                return;
-            }
-
-            // Detect transfer complete
-            if(irpts & 0x2)
-            {
-#ifdef EMMC_DEBUG
-                printf("SD: SDMA transfer complete\r\n");
-#endif
-                // Transfer the data to the user buffer
-                memcpy(dev->buf, (const void *)SDMA_BUFFER, dev->block_size);
-            }
-            else
-            {
-                // Unknown error
-#ifdef EMMC_DEBUG
-                if(irpts == 0)
-                    printf("SD: timeout waiting for SDMA transfer to complete\r\n");
-                else
-                    printf("SD: unknown SDMA transfer error\r\n");
-
-                printf("SD: INTERRUPT: %08"PRIx32", STATUS %08"PRIx32"\r\n", irpts,
-                       mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_STATUS));
-#endif
-
-                if((irpts == 0) && ((mmio_read(_get_peripheral_base() + EMMC_BASE + EMMC_STATUS) & 0x3) == 0x2))
-                {
-                    // The data transfer is ongoing, we should attempt to stop
-                    //  it
-#ifdef EMMC_DEBUG
-                    printf("SD: aborting transfer\r\n");
-#endif
-                    mmio_write(_get_peripheral_base() + EMMC_BASE + EMMC_CMDTM, sd_commands[STOP_TRANSMISSION]);
-
-#ifdef EMMC_DEBUG
-                    // pause to let us read the screen
-                    usleep(2000000);
-#endif
-                }
-                dev->last_error = irpts & 0xffff0000;
-                dev->last_interrupt = irpts;
-                return;
-            }
-        }
-    }
 
     // Return success
     dev->last_cmd_success = 1;
@@ -1724,6 +1713,7 @@ int sd_card_init(struct block_device **dev)
    ret->buf = &ret->scr->scr[0];
    ret->block_size = 8;
    ret->blocks_to_transfer = 1;
+   ret->use_sdma = 0;   // read by PIO, it's only 8 bytes
    sd_issue_command(ret, SEND_SCR, 0, 500000);
    ret->block_size = 512;
    if(FAIL(ret))
@@ -1911,17 +1901,6 @@ static int sd_ensure_data_mode(struct emmc_block_dev *edev)
    return 0;
 }
 
-#ifdef SDMA_SUPPORT
-// We only support DMA transfers to buffers aligned on a 4 kiB boundary
-static int sd_suitable_for_dma(void *buf)
-{
-    if((uintptr_t)buf & 0xfff)
-        return 0;
-    else
-        return 1;
-}
-#endif
-
 static int sd_do_data_command(struct emmc_block_dev *edev, int is_write, uint8_t *buf, size_t buf_size, uint32_t block_no)
 {
    // PLSS table 4.20 - SDSC cards use byte addresses rather than block addresses
@@ -1966,14 +1945,18 @@ static int sd_do_data_command(struct emmc_block_dev *edev, int is_write, uint8_t
    int max_retries = 3;
    while(retry_count < max_retries)
    {
-#ifdef SDMA_SUPPORT
-       // use SDMA for the first try only
-       if((retry_count == 0) && sd_suitable_for_dma(buf))
+#ifdef SD_DMA_SUPPORT
+       // use DMA for the first try only
+       if((retry_count == 0) && sd_dma_channel)
+       {
             edev->use_sdma = 1;
+            if(is_write)
+                memcpy((void *)SD_DMA_BUFFER, buf, buf_size);
+       }
         else
         {
 #ifdef EMMC_DEBUG
-            printf("SD: retrying without SDMA\r\n");
+            printf("SD: retrying without DMA\r\n");
 #endif
             edev->use_sdma = 0;
         }
@@ -1983,6 +1966,11 @@ static int sd_do_data_command(struct emmc_block_dev *edev, int is_write, uint8_t
 
         sd_issue_command(edev, command, block_no, 5000000);
 
+#ifdef SD_DMA_SUPPORT
+        if(edev->use_sdma && !sd_dma_finish(edev))
+            edev->last_cmd_success = 0;
+#endif
+
         if(SUCCESS(edev))
             break;
         else
@@ -2002,6 +1990,30 @@ static int sd_do_data_command(struct emmc_block_dev *edev, int is_write, uint8_t
         return -1;
     }
 
+#ifdef SD_DMA_SUPPORT
+    if(edev->use_sdma && !is_write)
+        memcpy(buf, (const void *)SD_DMA_BUFFER, buf_size);
+#endif
+
+    return 0;
+}
+
+// Splits the transfer into runs that fit the DMA bounce buffer, each one command
+static int sd_do_data_commands(struct emmc_block_dev *edev, int is_write, uint8_t *buf, size_t buf_size, uint32_t block_no)
+{
+    while(buf_size)
+    {
+        size_t run = buf_size;
+#ifdef SD_DMA_SUPPORT
+        if(sd_dma_channel && run > SD_DMA_BUFFER_SIZE)
+            run = SD_DMA_BUFFER_SIZE;
+#endif
+        if(sd_do_data_command(edev, is_write, buf, run, block_no) < 0)
+            return -1;
+        buf += run;
+        buf_size -= run;
+        block_no += run / edev->block_size;
+    }
     return 0;
 }
 
@@ -2017,7 +2029,7 @@ size_t sd_read(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_t
    printf("SD: read() card ready, reading from block %"PRIu32"\r\n", block_no);
 #endif
 
-    if(sd_do_data_command(edev, 0, buf, buf_size, block_no) < 0)
+    if(sd_do_data_commands(edev, 0, buf, buf_size, block_no) < 0)
         return -1;
 
 #ifdef EMMC_DEBUG
@@ -2039,7 +2051,7 @@ size_t sd_write(struct block_device *dev, uint8_t *buf, size_t buf_size, uint32_
    printf("SD: write() card ready, writing to block %"PRIu32"\r\n", block_no);
 #endif
 
-    if(sd_do_data_command(edev, 1, buf, buf_size, block_no) < 0)
+    if(sd_do_data_commands(edev, 1, buf, buf_size, block_no) < 0)
         return -1;
 
 #ifdef EMMC_DEBUG
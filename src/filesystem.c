@@ -4,14 +4,19 @@
 #include <stdint.h>
 #include "logging.h"
 #include "fatfs/ff.h"
+#include "fatfs/diskio.h"
 #include "filesystem.h"
 #include "osd.h"
 #include "rgb_to_fb.h"
 #include "geometry.h"
 #include "rgb_to_hdmi.h"
 #include "startup.h"
+#include "recording.h"
+#include "gitversion.h"
 
-#define USE_LODEPNG
+// lodepng builds the whole image and the whole compressed file in memory, otherwise
+// the screenshot is streamed to the SD card a row at a time through TinyPngOut
+// #define USE_LODEPNG
 
 #ifdef USE_LODEPNG
 #include "lodepng.h"
@@ -27,33 +32,40 @@
 #define PALETTES_TYPE ".bin"
 
 static FATFS fsObject;
+static volatile int fs_mounted = 0;
 static int capture_id = -1;
 
-#ifdef USE_LODEPNG
-
-static int generate_png(capture_info_t *capinfo, uint8_t **png, unsigned int *png_len ) {
-   LodePNGState state;
-   lodepng_state_init(&state);
-   if (capinfo->bpp < 16) {
-       state.info_raw.colortype = LCT_PALETTE;
-       state.info_raw.bitdepth = 8;
-       state.info_png.color.colortype = LCT_PALETTE;
-       state.info_png.color.bitdepth = 8;
-       for (int i = 0; i < (1 << capinfo->bpp); i++) {
-          int triplet = osd_get_palette(i);
-          int r = triplet & 0xff;
-          int g = (triplet >> 8) & 0xff;
-          int b = (triplet >> 16) & 0xff;
-          lodepng_palette_add(&state.info_png.color, r, g, b, 255);
-          lodepng_palette_add(&state.info_raw, r, g, b, 255);
-       }
-   } else {
-       state.info_raw.colortype = LCT_RGB;
-       state.info_raw.bitdepth = 8;
-       state.info_png.color.colortype = LCT_RGB;
-       state.info_png.color.bitdepth = 8;
+// The volume is mounted the first time it is needed and then stays mounted, so each
+// file operation doesn't re-read the boot sector and FSInfo. Only one core touches the
+// card at a time (see init_filesystem), which also covers fs_mounted.
+static FRESULT mount_filesystem() {
+   if (fs_mounted) {
+      return FR_OK;
    }
+   disk_cache_invalidate();
+   FRESULT result = f_mount(&fsObject, "", 1);
+   fs_mounted = (result == FR_OK);
+   return result;
+}
 
+typedef struct {
+   int width;        // source pixels used from each line
+   int height;       // source lines used
+   int hscale;
+   int vscale;
+   int hdouble;
+   int vdouble;
+   int leftclip;     // source pixels outside leftclip..rightclip are dropped for 4:3
+   int rightclip;
+   int png_width;    // scaled image size, not including the border
+   int png_height;
+   int png_left;     // black border to match the display overscan (16bpp only)
+   int png_right;
+   int png_top;
+   int png_bottom;
+} png_geometry_t;
+
+static void get_png_geometry(capture_info_t *capinfo, png_geometry_t *g) {
    int width = capinfo->width;
    int width43 = width;
    int height = capinfo->height;
@@ -85,241 +97,218 @@ static int generate_png(capture_info_t *capinfo, uint8_t **png, unsigned int *pn
 
    png_width = (width43 >> hdouble) * hscale;
 
-   int leftclip = (width - width43) / 2;
-   int rightclip = leftclip + width43;
+   g->leftclip = (width - width43) / 2;
+   g->rightclip = g->leftclip + width43;
 
    log_info("Scaling is %d x %d x=%d y=%d sx=%d sy=%d px=%d py=%d", hscale, vscale, width, height, width/(hdouble + 1), height/(vdouble + 1), png_width, png_height);
 
-   width = (width >> hdouble) << hdouble;
-   width43 = (width >> hdouble) << hdouble;
-   height = (height >> vdouble) << vdouble;
+   g->width = (width >> hdouble) << hdouble;
+   g->height = (height >> vdouble) << vdouble;
+   g->hscale = hscale;
+   g->vscale = vscale;
+   g->hdouble = hdouble;
+   g->vdouble = vdouble;
+   g->png_width = png_width;
+   g->png_height = png_height;
+   g->png_left = 0;
+   g->png_right = 0;
+   g->png_top = 0;
+   g->png_bottom = 0;
 
    if (capinfo->bpp == 16) {
        int left;
        int right;
        int top;
        int bottom;
-       int png_left = 0;
-       int png_right = 0;
-       int png_top = 0;
-       int png_bottom = 0;
-
        get_config_overscan(&left, &right, &top, &bottom);
        if (get_startup_overscan() != 0 && (left != 0 || right != 0) && (capscale == SCREENCAP_HALF || capscale == SCREENCAP_FULL)) {
-           png_left = left * png_width / (get_hdisplay() - left - right);
-           png_right = right * png_width / (get_hdisplay() - left - right);
-           png_top = top * png_height / (get_vdisplay() - top - bottom);
-           png_bottom = bottom * png_height / (get_vdisplay() - top - bottom);
+           g->png_left = left * png_width / (get_hdisplay() - left - right);
+           g->png_right = right * png_width / (get_hdisplay() - left - right);
+           g->png_top = top * png_height / (get_vdisplay() - top - bottom);
+           g->png_bottom = bottom * png_height / (get_vdisplay() - top - bottom);
        }
+   }
+}
 
-       uint8_t png_buffer[(png_width + png_left + png_right) *3 * (png_height + png_top + png_bottom)]  __attribute__((aligned(32)));
-       uint8_t *pp = png_buffer;
-
-           if (png_top != 0) {
-               for (int i = 0; i < (png_top * (png_left + png_width + png_right)); i++) {
-                    *pp++ = 0;
-                    *pp++ = 0;
-                    *pp++ = 0;
-               }
+// Converts frame buffer line y into one row of the PNG: RGB triplets at 16bpp
+// (including the border), palette indices at 4 and 8bpp. Returns the next free byte.
+static uint8_t *get_png_row(capture_info_t *capinfo, png_geometry_t *g, int y, uint8_t *pp) {
+   uint8_t *fp = capinfo->fb + capinfo->pitch * y;
+   int width = g->width;
+   int hdouble = g->hdouble;
+   int hscale = g->hscale;
+   int leftclip = g->leftclip;
+   int rightclip = g->rightclip;
+   if (capinfo->bpp == 16) {
+       for (int x = 0; x < g->png_left; x++) {
+           *pp++ = 0;
+           *pp++ = 0;
+           *pp++ = 0;
+       }
+       for (int x = 0; x < width; x += (hdouble + 1)) {
+           uint8_t  single_pixel_lo = *fp++;
+           uint8_t  single_pixel_hi = *fp++;
+           int single_pixel = single_pixel_lo | (single_pixel_hi << 8);
+           uint8_t single_pixel_A = (single_pixel >> 12) & 0x0f;
+           uint8_t single_pixel_R = (single_pixel >> 8) & 0x0f;
+           uint8_t single_pixel_G = (single_pixel >> 4) & 0x0f;
+           uint8_t single_pixel_B = single_pixel & 0x0f;
+           if (single_pixel_A != 0x0f) {
+               single_pixel_R = single_pixel_R * single_pixel_A / 15;
+               single_pixel_G = single_pixel_G * single_pixel_A / 15;
+               single_pixel_B = single_pixel_B * single_pixel_A / 15;
            }
-
-
-           for (int y = 0; y < height; y += (vdouble + 1)) {
-                for (int sy = 0; sy < vscale; sy++) {
-                    uint8_t *fp = capinfo->fb + capinfo->pitch * y;
-                    if (png_left != 0) {
-                        for (int x = 0; x < png_left; x++) {
-                            *pp++ = 0;
-                            *pp++ = 0;
-                            *pp++ = 0;
-                        }
-                    }
-                    for (int x = 0; x < width; x += (hdouble + 1)) {
-                        uint8_t  single_pixel_lo = *fp++;
-                        uint8_t  single_pixel_hi = *fp++;
-                        int single_pixel = single_pixel_lo | (single_pixel_hi << 8);
-                        uint8_t single_pixel_A = (single_pixel >> 12) & 0x0f;
-                        uint8_t single_pixel_R = (single_pixel >> 8) & 0x0f;
-                        uint8_t single_pixel_G = (single_pixel >> 4) & 0x0f;
-                        uint8_t single_pixel_B = single_pixel & 0x0f;
-                        if (single_pixel_A != 0x0f) {
-                            single_pixel_R = single_pixel_R * single_pixel_A / 15;
-                            single_pixel_G = single_pixel_G * single_pixel_A / 15;
-                            single_pixel_B = single_pixel_B * single_pixel_A / 15;
-                        }
-                        single_pixel_R |= (single_pixel_R << 4);
-                        single_pixel_G |= (single_pixel_G << 4);
-                        single_pixel_B |= (single_pixel_B << 4);
-                        if (hdouble) fp += 2;
-                        if (x >= leftclip && x < rightclip) {
-                            for (int sx = 0; sx < hscale; sx++) {
-                                *pp++ = single_pixel_R;
-                                *pp++ = single_pixel_G;
-                                *pp++ = single_pixel_B;
-                            }
-                        }
-                    }
-                    if (png_right != 0) {
-                        for (int x = 0; x < png_right; x++) {
-                            *pp++ = 0;
-                            *pp++ = 0;
-                            *pp++ = 0;
-                        }
-                    }
-
-                }
+           single_pixel_R |= (single_pixel_R << 4);
+           single_pixel_G |= (single_pixel_G << 4);
+           single_pixel_B |= (single_pixel_B << 4);
+           if (hdouble) fp += 2;
+           if (x >= leftclip && x < rightclip) {
+               for (int sx = 0; sx < hscale; sx++) {
+                   *pp++ = single_pixel_R;
+                   *pp++ = single_pixel_G;
+                   *pp++ = single_pixel_B;
+               }
            }
-           if (png_bottom != 0) {
-               for (int i = 0; i < (png_bottom * (png_left + png_width + png_right)); i++) {
-                   *pp++ = 0;
-                   *pp++ = 0;
-                   *pp++ = 0;
+       }
+       for (int x = 0; x < g->png_right; x++) {
+           *pp++ = 0;
+           *pp++ = 0;
+           *pp++ = 0;
+       }
+   } else if (capinfo->bpp == 8) {
+       for (int x = 0; x < width; x += (hdouble + 1)) {
+           uint8_t single_pixel = *fp++;
+           if (hdouble) fp++;
+           if (x >= leftclip && x < rightclip) {
+               for (int sx = 0; sx < hscale; sx++) {
+                   *pp++ = single_pixel;
                }
            }
-       //log_info("Encoding png %08X, %08X", png, png_buffer);
-       unsigned int result = lodepng_encode(png, png_len, png_buffer, (png_width + png_left + png_right), png_height + png_top + png_bottom, &state);
-       if (result) {
-          log_warn("lodepng_encode32 failed (result = %d)", result);
-          return 1;
        }
-       return 0;
    } else {
-   uint8_t png_buffer[png_width * png_height]  __attribute__((aligned(32)));
-   uint8_t *pp = png_buffer;
-       if (capinfo->bpp == 8) {
-           for (int y = 0; y < height; y += (vdouble + 1)) {
-                for (int sy = 0; sy < vscale; sy++) {
-                    uint8_t *fp = capinfo->fb + capinfo->pitch * y;
-                    for (int x = 0; x < width; x += (hdouble + 1)) {
-                        uint8_t single_pixel = *fp++;
-                        if (hdouble) fp++;
-                        if (x >= leftclip && x < rightclip) {
-                            for (int sx = 0; sx < hscale; sx++) {
-                                *pp++ = single_pixel;
-                            }
-                        }
-                    }
-                }
-           }
-       } else {
-           for (int y = 0; y < height; y += (vdouble + 1)) {
-                for (int sy = 0; sy < vscale; sy++) {
-                    uint8_t *fp = capinfo->fb + capinfo->pitch * y;
-                    uint8_t single_pixel = 0;
-                    for (int x = 0; x < width; x += (hdouble + 1)) {
-                        if (hdouble) {
-                            single_pixel = *fp++;
-                            if (x >= leftclip && x < rightclip) {
-                                for (int sx = 0; sx < hscale; sx++) {
-                                    *pp++ = single_pixel >> 4;
-                                }
-                            }
-                        } else {
-                            if ((x & 1) == 0) {
-                                single_pixel = *fp++;
-                                if (x >= leftclip && x < rightclip) {
-                                    for (int sx = 0; sx < hscale; sx++) {
-                                        *pp++ = single_pixel >> 4;
-                                    }
-                                }
-                            } else {
-                                if (x >= leftclip && x < rightclip) {
-                                    for (int sx = 0; sx < hscale; sx++) {
-                                        *pp++ = single_pixel & 0x0f;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+       uint8_t single_pixel = 0;
+       for (int x = 0; x < width; x += (hdouble + 1)) {
+           if (hdouble) {
+               single_pixel = *fp++;
+               if (x >= leftclip && x < rightclip) {
+                   for (int sx = 0; sx < hscale; sx++) {
+                       *pp++ = single_pixel >> 4;
+                   }
+               }
+           } else {
+               if ((x & 1) == 0) {
+                   single_pixel = *fp++;
+                   if (x >= leftclip && x < rightclip) {
+                       for (int sx = 0; sx < hscale; sx++) {
+                           *pp++ = single_pixel >> 4;
+                       }
+                   }
+               } else {
+                   if (x >= leftclip && x < rightclip) {
+                       for (int sx = 0; sx < hscale; sx++) {
+                           *pp++ = single_pixel & 0x0f;
+                       }
+                   }
+               }
            }
        }
-       //log_info("Encoding png %08X, %08X", png, png_buffer);
-       unsigned int result = lodepng_encode(png, png_len, png_buffer, png_width, png_height, &state);
-       if (result) {
-          log_warn("lodepng_encode32 failed (result = %d)", result);
-          return 1;
-       }
-       return 0;
-   }
-
-
-}
-
-static void free_png(uint8_t *png) {
-   if (png) {
-      free(png);
    }
+   return pp;
 }
 
-#else
-
-// TODO: Fix hard-coded max H resolution of 4096
-static uint8_t pixels[3 * 4096]  __attribute__((aligned(32)));
-
-static uint8_t png_buffer[8 * 1024 * 1024] __attribute__((aligned(0x4000)));
+#ifdef USE_LODEPNG
 
 static int generate_png(capture_info_t *capinfo, uint8_t **png, unsigned int *png_len ) {
-   enum TinyPngOut_Status result;
-   struct TinyPngOut state;
-
-   *png = NULL;
-   *png_len = 0;
-
-   result = TinyPngOut_init(&state, capinfo->width, capinfo->height, png_buffer);
-
-   if (result != TINYPNGOUT_OK) {
-
-      log_warn("TinyPngOut_init failed (result = %d)", result);
-      return 1;
-
+   LodePNGState state;
+   lodepng_state_init(&state);
+   if (capinfo->bpp < 16) {
+       state.info_raw.colortype = LCT_PALETTE;
+       state.info_raw.bitdepth = 8;
+       state.info_png.color.colortype = LCT_PALETTE;
+       state.info_png.color.bitdepth = 8;
+       for (int i = 0; i < (1 << capinfo->bpp); i++) {
+          int triplet = osd_get_palette(i);
+          int r = triplet & 0xff;
+          int g = (triplet >> 8) & 0xff;
+          int b = (triplet >> 16) & 0xff;
+          lodepng_palette_add(&state.info_png.color, r, g, b, 255);
+          lodepng_palette_add(&state.info_raw, r, g, b, 255);
+       }
    } else {
+       state.info_raw.colortype = LCT_RGB;
+       state.info_raw.bitdepth = 8;
+       state.info_png.color.colortype = LCT_RGB;
+       state.info_png.color.bitdepth = 8;
+   }
 
-      // TODO: Take account of current palette
-
-      for (int y = 0; y < capinfo->height; y++) {
-         uint8_t *fp = capinfo->fb + capinfo->pitch * y;
-         uint8_t *pp = pixels;
-         if (capinfo->bpp == 8) {
-            for (int x = 0; x < capinfo->width; x++) {
-               uint8_t single_pixel = *fp++;
-               *pp++ = (single_pixel & 0x01) ? 255 : 0;
-               *pp++ = (single_pixel & 0x02) ? 255 : 0;
-               *pp++ = (single_pixel & 0x04) ? 255 : 0;
-            }
-         } else {
-            for (int x = 0; x < capinfo->width << 1; x++) {
-               uint8_t double_pixel = *fp++;
-               *pp++ = (double_pixel & 0x10) ? 255 : 0;
-               *pp++ = (double_pixel & 0x20) ? 255 : 0;
-               *pp++ = (double_pixel & 0x40) ? 255 : 0;
-               *pp++ = (double_pixel & 0x01) ? 255 : 0;
-               *pp++ = (double_pixel & 0x02) ? 255 : 0;
-               *pp++ = (double_pixel & 0x04) ? 255 : 0;
-            }
-         }
+   png_geometry_t g;
+   get_png_geometry(capinfo, &g);
 
-         result = TinyPngOut_write(&state, pixels, capinfo->width);
+   int bytes_per_pixel = (capinfo->bpp == 16) ? 3 : 1;
+   int row_width = g.png_width + g.png_left + g.png_right;
+   int row_bytes = row_width * bytes_per_pixel;
+   int rows = g.png_height + g.png_top + g.png_bottom;
 
-         if (result != TINYPNGOUT_OK) {
-            log_warn("TinyPngOut_write failed (result = %d)", result);
-            return 1;
-         }
-      }
+   uint8_t png_buffer[row_bytes * rows]  __attribute__((aligned(32)));
+   uint8_t *pp = png_buffer;
+
+   memset(pp, 0, row_bytes * g.png_top);
+   pp += row_bytes * g.png_top;
+   for (int y = 0; y < g.height; y += (g.vdouble + 1)) {
+       for (int sy = 0; sy < g.vscale; sy++) {
+           pp = get_png_row(capinfo, &g, y, pp);
+       }
    }
+   memset(pp, 0, row_bytes * g.png_bottom);
 
-   *png = png_buffer;
-   *png_len = state.output_len;
+   //log_info("Encoding png %08X, %08X", png, png_buffer);
+   unsigned int result = lodepng_encode(png, png_len, png_buffer, row_width, rows, &state);
+   if (result) {
+      log_warn("lodepng_encode32 failed (result = %d)", result);
+      return 1;
+   }
    return 0;
 }
 
 static void free_png(uint8_t *png) {
+   if (png) {
+      free(png);
+   }
 }
 
 #endif
 
-
-static void initialize_capture_id(char * path) {
+// Screenshots and log saves are set up on the capture core and then, when a worker core
+// is free, handed to it along with a copy of the data so capture carries on while the file
+// is written. Jobs never log, the outcome is reported on the capture core afterwards.
+
+#define IO_JOB_FILE       0
+#define IO_JOB_SCREENSHOT 1
+
+typedef struct {
+   int type;
+   char path[MAX_STRING_SIZE];      // file to write, or capture directory
+   char *buffer;                    // IO_JOB_FILE data
+   unsigned int length;
+#ifndef USE_LODEPNG
+   capture_info_t capinfo;          // fb points at the page (or the copy of it) to encode
+   png_geometry_t geometry;
+   uint32_t palette[256];
+   uint32_t *pp;                    // palette, or NULL at 16bpp
+   char filepath[MAX_STRING_SIZE];  // capture file chosen by the job
+#endif
+   FRESULT result;                  // FR_OK, or the result of the step that failed
+   const char *failed;              // the step that failed
+   unsigned int written;
+} io_job_t;
+
+static io_job_t io_job;
+static volatile int io_job_busy = 0;    // cleared by the worker core when the job is done
+static int io_job_pending = 0;          // the job has been posted but not yet reported
+static uint8_t *io_job_buffer = NULL;   // copy of the data for the worker, only grows
+static unsigned int io_job_buffer_size = 0;
+
+static FRESULT scan_capture_id(char * path) {
    FRESULT result;
    DIR dir;
    FILINFO fno;
@@ -333,8 +322,7 @@ static void initialize_capture_id(char * path) {
    // Open root directory
    result = f_opendir(&dir, path);
    if (result != FR_OK) {
-      log_warn("Failed to open %s", path);
-      return;
+      return result;
    }
 
    // Iterate through files in root directory looking for existing capture files
@@ -344,7 +332,6 @@ static void initialize_capture_id(char * path) {
    do {
       result = f_readdir(&dir, &fno);
       if (result != FR_OK) {
-         log_warn("Failed to read %s", path);
          break;
       }
       len = strlen(fno.fname);
@@ -361,31 +348,221 @@ static void initialize_capture_id(char * path) {
    capture_id++;
 
    // Close root directory
-   result = f_closedir(&dir);
-   if (result != FR_OK) {
-      log_warn("Failed to close %s", path);
+   FRESULT close_result = f_closedir(&dir);
+   return result != FR_OK ? result : close_result;
+}
+
+#ifndef USE_LODEPNG
+
+// Output is handed to f_write in blocks of this size
+#define PNG_BLOCK_SIZE (32 * 1024)
+
+static uint8_t png_block[PNG_BLOCK_SIZE] __attribute__((aligned(32)));
+static struct TinyPngOut_Deflate png_deflate;
+
+static bool png_write_block(void *context, const uint8_t data[], size_t len) {
+   FIL *file = (FIL *) context;
+   UINT num_written = 0;
+   io_job.result = f_write(file, (void *) data, len, &num_written);
+   if (io_job.result == FR_OK && num_written != len) {
+      io_job.result = FR_DENIED;   // volume full
+   }
+   return io_job.result == FR_OK;
+}
+
+static int stream_png(io_job_t *job, FIL *file) {
+   struct TinyPngOut state;
+   capture_info_t *capinfo = &job->capinfo;
+   png_geometry_t *g = &job->geometry;
+
+   int row_width = g->png_width + g->png_left + g->png_right;
+   int rows = g->png_height + g->png_top + g->png_bottom;
+   uint8_t row[row_width * 3]  __attribute__((aligned(32)));
+
+   job->failed = "write";
+   enum TinyPngOut_Status result = TinyPngOut_init_stream(&state, row_width, rows, job->pp, 1 << capinfo->bpp, png_block, PNG_BLOCK_SIZE, png_write_block, file, &png_deflate);
+
+   // each source line is converted once and then written vscale times
+   memset(row, 0, sizeof(row));
+   for (int y = 0; y < g->png_top && result == TINYPNGOUT_OK; y++) {
+      result = TinyPngOut_write(&state, row, row_width);
+   }
+   for (int y = 0; y < g->height && result == TINYPNGOUT_OK; y += (g->vdouble + 1)) {
+      get_png_row(capinfo, g, y, row);
+      for (int sy = 0; sy < g->vscale && result == TINYPNGOUT_OK; sy++) {
+         result = TinyPngOut_write(&state, row, row_width);
+      }
+   }
+   memset(row, 0, sizeof(row));
+   for (int y = 0; y < g->png_bottom && result == TINYPNGOUT_OK; y++) {
+      result = TinyPngOut_write(&state, row, row_width);
+   }
+   if (result != TINYPNGOUT_OK && job->result == FR_OK) {
+      job->failed = "encode";
+      job->result = FR_INT_ERR;
+   }
+   return result != TINYPNGOUT_OK;
+}
+
+static void run_screenshot_job(io_job_t *job) {
+   FIL file;
+
+   job->result = f_mkdir(CAPTURE_BASE);
+   if (job->result != FR_OK && job->result != FR_EXIST) {
+      job->failed = "create directory";
+      return;
+   }
+   job->result = f_mkdir(job->path);
+   if (job->result != FR_OK && job->result != FR_EXIST) {
+      job->failed = "create directory";
+      return;
+   }
+   job->result = scan_capture_id(job->path);
+   if (job->result != FR_OK) {
+      job->failed = "scan directory";
+      return;
+   }
+   sprintf(job->filepath, "%s/%s%d.png", job->path, CAPTURE_FILE_BASE, capture_id);
+   job->result = f_open(&file, job->filepath, FA_CREATE_NEW | FA_WRITE);
+   if (job->result != FR_OK) {
+      job->failed = "create";
+      return;
+   }
+   capture_id++;
+   stream_png(job, &file);
+   job->written = f_size(&file);
+   FRESULT result = f_close(&file);
+   if (job->result == FR_OK && result != FR_OK) {
+      job->result = result;
+      job->failed = "close";
+   }
+}
+
+#endif
+
+static void run_file_job(io_job_t *job) {
+   FIL file;
+   job->result = f_open(&file, job->path, FA_WRITE | FA_CREATE_ALWAYS);
+   if (job->result != FR_OK) {
+      job->failed = "open";
+      return;
+   }
+   job->result = f_write(&file, job->buffer, job->length, &job->written);
+   if (job->result != FR_OK) {
+      job->failed = "write";
+   }
+   FRESULT result = f_close(&file);
+   if (job->result == FR_OK && result != FR_OK) {
+      job->result = result;
+      job->failed = "close";
+   }
+}
+
+static void run_io_job(io_job_t *job) {
+   job->written = 0;
+   job->failed = "mount";
+   job->result = mount_filesystem();
+   if (job->result != FR_OK) {
+      return;
+   }
+#ifndef USE_LODEPNG
+   if (job->type == IO_JOB_SCREENSHOT) {
+      run_screenshot_job(job);
+   } else
+#endif
+   {
+      run_file_job(job);
+   }
+}
+
+static void report_io_job(io_job_t *job) {
+   char *name = job->path;
+   UINT suppressed = disk_take_suppressed_messages();
+   if (suppressed) {
+      log_warn("%d SD card messages from the worker core were not shown", suppressed);
+   }
+#ifndef USE_LODEPNG
+   if (job->type == IO_JOB_SCREENSHOT && job->result == FR_OK) {
+      name = job->filepath;
+   }
+#endif
+   if (job->result != FR_OK) {
+      log_warn("Failed to %s %s (result = %d)", job->failed, name, job->result);
+   } else if (job->type == IO_JOB_FILE && job->written != job->length) {
+      log_warn("%s is incomplete (%d < %d bytes)", name, job->written, job->length);
+   } else {
+      log_info("Saved %s (%d bytes)", name, job->written);
    }
 }
 
+static void background_io_job(int arg0, int arg1, int arg2, int arg3) {
+   run_io_job(&io_job);
+   __data_memory_barrier();
+   io_job_busy = 0;
+}
+
+// Returns a buffer of at least length bytes for a copy of the job's data, or NULL if
+// there is no worker core to run it on
+static uint8_t *get_io_job_buffer(unsigned int length) {
+   if (get_worker_cores() == 0) {
+      return NULL;
+   }
+   if (length > io_job_buffer_size) {
+      free(io_job_buffer);
+      io_job_buffer = malloc(length);
+      io_job_buffer_size = io_job_buffer ? length : 0;
+   }
+   return io_job_buffer;
+}
+
+static int post_io_job() {
+   io_job_busy = 1;
+   if (post_core_job(background_io_job, 0, 0, 0, 0) == 0) {
+      io_job_busy = 0;
+      return 0;
+   }
+   io_job_pending = 1;
+   return 1;
+}
+
+static void wait_for_io_job() {
+   if (io_job_pending) {
+      while (io_job_busy);
+      __data_memory_barrier();
+      io_job_pending = 0;
+      report_io_job(&io_job);
+   }
+}
+
+void filesystem_poll() {
+   if (io_job_pending && !io_job_busy) {
+      wait_for_io_job();
+   }
+}
 
 void init_filesystem() {
-   FRESULT result;
+   // This is the sync point between the main core and anything writing to the card
+   // from a worker core, the volume itself stays mounted
+   wait_for_io_job();
+   recording_stop();   // the recording writes to the card behind FatFS's back
 
-   // Mount file system
-   result = f_mount(&fsObject, "", 1);
-   if (result != FR_OK) {
+   if (mount_filesystem() != FR_OK) {
       log_warn("Failed to initialize file system");
-      return;
    }
 }
 
 void close_filesystem() {
-   FRESULT result;
+   // Nothing to do: every f_close has already written back the FAT, directory entry
+   // and FSInfo, and the sector cache in diskio.c is write through, so the card is
+   // up to date whenever no file is open
+}
+
+#ifdef USE_LODEPNG
 
-   // UnMount file system
-   result = f_mount(NULL, "", 1);
+static void initialize_capture_id(char * path) {
+   FRESULT result = scan_capture_id(path);
    if (result != FR_OK) {
-      log_warn("Failed to close file system");
+      log_warn("Failed to scan %s (result = %d)", path, result);
    }
 }
 
@@ -463,6 +640,56 @@ void capture_screenshot(capture_info_t *capinfo, char *profile) {
 
 }
 
+#else
+
+void capture_screenshot(capture_info_t *capinfo, char *profile) {
+   io_job_t *job = &io_job;
+
+   init_filesystem();   // the job, or the fallback inline, must not share the card with a recording
+
+   job->type = IO_JOB_SCREENSHOT;
+   char *position = strchr(profile, '/');
+   sprintf(job->path, "%s/%s", CAPTURE_BASE, position ? position + 1 : profile);
+
+   memcpy(&job->capinfo, capinfo, sizeof(capture_info_t));
+   get_png_geometry(capinfo, &job->geometry);
+   job->pp = NULL;
+   if (capinfo->bpp < 16) {
+      for (int i = 0; i < (1 << capinfo->bpp); i++) {
+         job->palette[i] = osd_get_palette(i) & 0xffffff;
+      }
+      job->pp = job->palette;
+   }
+
+   // the page being displayed is the one capture is not drawing into
+   uint8_t *page = capinfo->fb + capinfo->pitch * capinfo->height * get_current_display_buffer();
+   unsigned int page_size = capinfo->pitch * capinfo->height;
+   uint8_t *copy = get_io_job_buffer(page_size);
+   if (copy) {
+      memcpy(copy, page, page_size);
+      job->capinfo.fb = copy;
+      if (post_io_job()) {
+         log_info("Screen capture queued, directory = %s", job->path);
+         osd_clear();
+         osd_set_noupdate(0, ATTR_DOUBLE_SIZE, "Screen Capture");
+         osd_set_clear(2, 0, job->path);
+         return;
+      }
+   }
+
+   log_info("Screen capture starting, directory = %s", job->path);
+   job->capinfo.fb = page;
+   run_io_job(job);
+   report_io_job(job);
+
+   // the OSD is drawn into the frame buffer so only show it once the image has been written
+   osd_clear();
+   osd_set_noupdate(0, ATTR_DOUBLE_SIZE, "Screen Capture");
+   osd_set_clear(2, 0, job->result == FR_OK ? job->filepath : job->path);
+}
+
+#endif
+
 void write_profile_choice(char *profile_name, int saved_config_number, char *cpld_name) {
    FRESULT result;
    FIL file;
@@ -612,125 +839,424 @@ void scan_cpld_filenames(char cpld_filenames[MAX_CPLD_FILENAMES][MAX_FILENAME_WI
     close_filesystem();
 }
 
-void scan_profiles(char *prefix, char manufacturer_names[MAX_PROFILES][MAX_PROFILE_WIDTH], char profile_names[MAX_PROFILES][MAX_PROFILE_WIDTH], int has_sub_profiles[MAX_PROFILES], char *path, size_t *mcount, size_t *count) {
-    int initial_count = *count;
+// Profile index
+//
+// Scanning the profile folders means a directory read per manufacturer and an f_open
+// per profile (to see whether it is a sub-profile folder), so the result is kept in
+// PROFILE_INDEX_NAME in each scanned folder and read back in one go on later boots.
+// The index is rebuilt whenever its signature no longer matches, which covers the
+// timestamp of the scanned folder, the names, sizes and timestamps of the entries in
+// it and in each manufacturer folder (FAT doesn't change a folder's timestamp when a
+// file in it is added or edited), the firmware version (so a new release always
+// rebuilds it) and whether the mono board filter applies. That is one directory read
+// per manufacturer rather than an f_open per profile. Changes inside a sub-profile
+// folder aren't seen, so the OSD can also remove every index to force a rebuild.
+//
+// Layout: profile_index_header_t, the manufacturer names, then for each profile a
+// flags byte, a sub-profile count byte, the name and the sub-profile names, all
+// strings nul terminated. Profile and sub-profile names are in sorted order.
+
+#define PROFILE_INDEX_NAME    "profile_index.bin"
+#define PROFILE_INDEX_MAGIC   0x58444950   // "PIDX"
+#define PROFILE_INDEX_VERSION 1
+#define PROFILE_INDEX_HAS_SUB 0x01
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t signature;
+   uint32_t size;
+   uint32_t manufacturers;
+   uint32_t profiles;
+} profile_index_header_t;
+
+typedef struct {
+   uint8_t *data;
+   unsigned int length;
+   unsigned int allocated;
+} profile_index_builder_t;
+
+// the index for this CPLD's own folder is kept for scan_sub_profiles
+static uint8_t *sub_profile_index = NULL;
+static char sub_profile_index_path[MAX_STRING_SIZE];
+static char index_sub_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH];
+
+static uint32_t index_hash(uint32_t hash, const void *data, unsigned int length) {
+   const uint8_t *p = data;
+   while (length--) {
+      hash = (hash ^ *p++) * 16777619;   // FNV-1a
+   }
+   return hash;
+}
+
+static uint32_t index_hash_entry(uint32_t hash, FILINFO *fno) {
+   uint32_t entry[2] = { fno->fsize, (fno->fdate << 16) | fno->ftime };
+   hash = index_hash(hash, fno->fname, strlen(fno->fname) + 1);
+   return index_hash(hash, entry, sizeof(entry));
+}
+
+static uint32_t profile_index_signature(char *path) {
+   DIR dir;
+   DIR sub_dir;
+   char sub_path[MAX_STRING_SIZE];
+   static FILINFO fno;
+   static FILINFO sub_fno;
+   uint32_t hash = index_hash(2166136261U, GITVERSION, strlen(GITVERSION));
+   uint32_t mono = mono_board_detected();
+   hash = index_hash(hash, &mono, sizeof(mono));
+   // the folder's own timestamp, then each entry in it and in each manufacturer folder
+   if (f_stat(path, &fno) == FR_OK) {
+      uint32_t timestamp = (fno.fdate << 16) | fno.ftime;
+      hash = index_hash(hash, &timestamp, sizeof(timestamp));
+   }
+   if (f_opendir(&dir, path) != FR_OK) {
+      return 0;
+   }
+   while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0) {
+      if (strcmp(fno.fname, PROFILE_INDEX_NAME) == 0) {
+         continue;   // rewritten whenever it is rebuilt
+      }
+      hash = index_hash_entry(hash, &fno);
+      if ((fno.fattrib & AM_DIR) && strcmp(fno.fname, PAXHEADER) != 0) {
+         snprintf(sub_path, MAX_STRING_SIZE, "%s/%s", path, fno.fname);
+         if (f_opendir(&sub_dir, sub_path) == FR_OK) {
+            while (f_readdir(&sub_dir, &sub_fno) == FR_OK && sub_fno.fname[0] != 0) {
+               hash = index_hash_entry(hash, &sub_fno);
+            }
+            f_closedir(&sub_dir);
+         }
+      }
+   }
+   f_closedir(&dir);
+   return hash;
+}
+
+static uint8_t *load_profile_index(char *path, uint32_t signature) {
+   FIL file;
+   char fpath[MAX_STRING_SIZE];
+   unsigned int bytes_read;
+   profile_index_header_t header;
+   sprintf(fpath, "%s/%s", path, PROFILE_INDEX_NAME);
+   if (f_open(&file, fpath, FA_READ) != FR_OK) {
+      return NULL;
+   }
+   uint8_t *index = NULL;
+   if (f_read(&file, &header, sizeof(header), &bytes_read) == FR_OK && bytes_read == sizeof(header)
+       && header.magic == PROFILE_INDEX_MAGIC && header.version == PROFILE_INDEX_VERSION
+       && header.signature == signature && header.size == f_size(&file)) {
+      index = malloc(header.size + 1);
+      if (index) {
+         memcpy(index, &header, sizeof(header));
+         if (f_read(&file, index + sizeof(header), header.size - sizeof(header), &bytes_read) != FR_OK
+             || bytes_read != header.size - sizeof(header)) {
+            free(index);
+            index = NULL;
+         } else {
+            index[header.size] = 0;   // stops a damaged index running off the end
+         }
+      }
+   }
+   f_close(&file);
+   return index;
+}
+
+static void save_profile_index(char *path, uint8_t *index) {
+   FIL file;
+   char fpath[MAX_STRING_SIZE];
+   unsigned int bytes_written;
+   profile_index_header_t *header = (profile_index_header_t *) index;
+   sprintf(fpath, "%s/%s", path, PROFILE_INDEX_NAME);
+   if (f_open(&file, fpath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+      log_warn("Failed to create %s", fpath);
+      return;
+   }
+   if (f_write(&file, index, header->size, &bytes_written) != FR_OK || bytes_written != header->size) {
+      log_warn("Failed to write %s", fpath);
+      f_close(&file);
+      f_unlink(fpath);
+      return;
+   }
+   f_close(&file);
+}
+
+static void index_append(profile_index_builder_t *b, const void *data, unsigned int length) {
+   if (!b->data) {
+      return;
+   }
+   if (b->length + length > b->allocated) {
+      unsigned int allocated = b->allocated * 2 + length;
+      uint8_t *data = realloc(b->data, allocated);
+      if (!data) {
+         free(b->data);
+         b->data = NULL;
+         return;
+      }
+      b->data = data;
+      b->allocated = allocated;
+   }
+   memcpy(b->data + b->length, data, length);
+   b->length += length;
+}
+
+static void scan_sub_profile_folder(char sub_profile_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH], char *path, size_t *count) {
     FRESULT res;
     DIR dir;
-    FIL file;
-    char fpath[MAX_STRING_SIZE];
     static FILINFO fno;
-    init_filesystem();
     res = f_opendir(&dir, path);
     if (res == FR_OK) {
         for (;;) {
             res = f_readdir(&dir, &fno);
-            if (res != FR_OK || fno.fname[0] == 0 || *mcount == MAX_PROFILES) break;
-            if (fno.fattrib & AM_DIR && strcmp(fno.fname, PAXHEADER) != 0) {
-                fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
-                if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
-                    int duplicate = 0;
-                    if (*mcount != 0) {
-                        for (int k = 0; k < *mcount; k++) {
-                            if (strcmp(fno.fname, manufacturer_names[k]) == 0) {
-                                duplicate = 1;
-                                break;
-                            }
-                        }
-                    }
-                    if (duplicate == 0) {
-                        strcpy(manufacturer_names[*mcount], fno.fname);
-                        (*mcount)++;
-                    } else {
+            if (res != FR_OK || fno.fname[0] == 0 || *count == MAX_SUB_PROFILES) break;
+            if (!(fno.fattrib & AM_DIR)) {
+                if (fno.fname[0] != '.' && strlen(fno.fname) > 4 && strcmp(fno.fname, DEFAULTTXT_STRING) != 0) {
+                    char* filetype = fno.fname + strlen(fno.fname)-4;
+                    if (strcmp(filetype, ".txt") == 0) {
+                        fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
+                        strcpy(sub_profile_names[*count], fno.fname);
+                        sub_profile_names[*count][strlen(fno.fname) - 4] = 0;
+                        (*count)++;
                     }
                 }
             }
         }
         f_closedir(&dir);
-        qsort(manufacturer_names, *mcount, sizeof *manufacturer_names, string_compare);
-        for (int i = 0; i < *mcount; i++) {
-            sprintf(fpath, "%s/%s", path, manufacturer_names[i]);
-            log_info("Scanning folder: %s", fpath);
-            res = f_opendir(&dir, fpath);
-            //log_info("result %X", res);
-            if (res == FR_OK) {
-                for (;;) {
-                    res = f_readdir(&dir, &fno);
-                    if (res != FR_OK || fno.fname[0] == 0 || *count == MAX_PROFILES) break;
-                    if (fno.fattrib & AM_DIR && strcmp(fno.fname, PAXHEADER) != 0) {
-                        fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
-                        if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
-                            sprintf(profile_names[*count], "%s%s/%s", prefix, manufacturer_names[i], fno.fname);
-                            log_info("Found profile: %s",  profile_names[*count]);
-                            (*count)++;
+        qsort(sub_profile_names, *count, sizeof *sub_profile_names, string_compare);
+    }
+}
+
+// The original directory walk, which also records what it finds in a new index
+static uint8_t *build_profile_index(char *prefix, char manufacturer_names[MAX_PROFILES][MAX_PROFILE_WIDTH], char profile_names[MAX_PROFILES][MAX_PROFILE_WIDTH], int has_sub_profiles[MAX_PROFILES], char *path, size_t *mcount, size_t *count, uint32_t signature) {
+    int initial_count = *count;
+    FRESULT res;
+    DIR dir;
+    FIL file;
+    char fpath[MAX_STRING_SIZE];
+    static FILINFO fno;
+    profile_index_header_t header;
+    profile_index_builder_t b;
+    memset(&header, 0, sizeof(header));
+    b.allocated = 0x4000;
+    b.length = 0;
+    b.data = malloc(b.allocated);
+    index_append(&b, &header, sizeof(header));
+    res = f_opendir(&dir, path);
+    if (res != FR_OK) {
+        free(b.data);
+        return NULL;
+    }
+    for (;;) {
+        res = f_readdir(&dir, &fno);
+        if (res != FR_OK || fno.fname[0] == 0 || *mcount == MAX_PROFILES) break;
+        if (fno.fattrib & AM_DIR && strcmp(fno.fname, PAXHEADER) != 0) {
+            fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
+            if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
+                index_append(&b, fno.fname, strlen(fno.fname) + 1);
+                header.manufacturers++;
+                int duplicate = 0;
+                if (*mcount != 0) {
+                    for (int k = 0; k < *mcount; k++) {
+                        if (strcmp(fno.fname, manufacturer_names[k]) == 0) {
+                            duplicate = 1;
+                            break;
                         }
-                    } else {
-                        if (fno.fname[0] != '.' && strlen(fno.fname) > 4 && strcmp(fno.fname, DEFAULTTXT_STRING) != 0) {
-                            char* filetype = fno.fname + strlen(fno.fname)-4;
-                            if (strcmp(filetype, ".txt") == 0) {
-                                fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
-                                fno.fname[strlen(fno.fname) - 4] = 0;
-                                if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
-                                    sprintf(profile_names[*count], "%s%s/%s", prefix, manufacturer_names[i], fno.fname);
-                                    log_info("Found profile: %s",  profile_names[*count]);
-                                    (*count)++;
-                                }
+                    }
+                }
+                if (duplicate == 0) {
+                    strcpy(manufacturer_names[*mcount], fno.fname);
+                    (*mcount)++;
+                } else {
+                }
+            }
+        }
+    }
+    f_closedir(&dir);
+    qsort(manufacturer_names, *mcount, sizeof *manufacturer_names, string_compare);
+    for (int i = 0; i < *mcount; i++) {
+        sprintf(fpath, "%s/%s", path, manufacturer_names[i]);
+        log_info("Scanning folder: %s", fpath);
+        res = f_opendir(&dir, fpath);
+        //log_info("result %X", res);
+        if (res == FR_OK) {
+            for (;;) {
+                res = f_readdir(&dir, &fno);
+                if (res != FR_OK || fno.fname[0] == 0 || *count == MAX_PROFILES) break;
+                if (fno.fattrib & AM_DIR && strcmp(fno.fname, PAXHEADER) != 0) {
+                    fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
+                    if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
+                        sprintf(profile_names[*count], "%s%s/%s", prefix, manufacturer_names[i], fno.fname);
+                        log_info("Found profile: %s",  profile_names[*count]);
+                        (*count)++;
+                    }
+                } else {
+                    if (fno.fname[0] != '.' && strlen(fno.fname) > 4 && strcmp(fno.fname, DEFAULTTXT_STRING) != 0) {
+                        char* filetype = fno.fname + strlen(fno.fname)-4;
+                        if (strcmp(filetype, ".txt") == 0) {
+                            fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
+                            fno.fname[strlen(fno.fname) - 4] = 0;
+                            if (mono_board_detected() == 0 || (mono_board_detected() == 1 && fno.fname[strlen(fno.fname) - 1] == '_')) {
+                                sprintf(profile_names[*count], "%s%s/%s", prefix, manufacturer_names[i], fno.fname);
+                                log_info("Found profile: %s",  profile_names[*count]);
+                                (*count)++;
                             }
                         }
                     }
                 }
-                f_closedir(&dir);
             }
+            f_closedir(&dir);
+        }
+    }
+    if (*count > initial_count) {
+        qsort(profile_names[initial_count], (*count) - initial_count, sizeof *profile_names, string_compare);
+    }
+    for (int i = initial_count; i < (*count); i++) {
+        char *name = profile_names[i] + strlen(prefix);
+        size_t sub_count = 0;
+        sprintf(fpath, "%s/%s.txt", path, name);
+        res = f_open(&file, fpath, FA_READ);
+        if (res == FR_OK) {
+            f_close(&file);
+            has_sub_profiles[i] = 0;
+        } else {
+            has_sub_profiles[i] = 1;
+            sprintf(fpath, "%s/%s", path, name);
+            scan_sub_profile_folder(index_sub_names, fpath, &sub_count);
         }
-        if (*count > initial_count) {
-            qsort(profile_names[initial_count], (*count) - initial_count, sizeof *profile_names, string_compare);
+        uint8_t flags[2] = { has_sub_profiles[i] ? PROFILE_INDEX_HAS_SUB : 0, sub_count };
+        index_append(&b, flags, sizeof(flags));
+        index_append(&b, name, strlen(name) + 1);
+        for (int j = 0; j < sub_count; j++) {
+            index_append(&b, index_sub_names[j], strlen(index_sub_names[j]) + 1);
         }
-        for (int i = initial_count; i < (*count); i++) {
-            sprintf(fpath, "%s/%s.txt", path, profile_names[i] + strlen(prefix));
-            res = f_open(&file, fpath, FA_READ);
-            if (res == FR_OK) {
-                f_close(&file);
-                has_sub_profiles[i] = 0;
-            } else {
-                has_sub_profiles[i] = 1;
+        header.profiles++;
+    }
+    if (!b.data) {
+        return NULL;
+    }
+    header.magic = PROFILE_INDEX_MAGIC;
+    header.version = PROFILE_INDEX_VERSION;
+    header.signature = signature;
+    header.size = b.length;
+    memcpy(b.data, &header, sizeof(header));
+    save_profile_index(path, b.data);
+    log_info("Rebuilt %s/%s (%d profiles, %d bytes)", path, PROFILE_INDEX_NAME, header.profiles, header.size);
+    return b.data;
+}
+
+static void read_profile_index(uint8_t *index, char *prefix, char manufacturer_names[MAX_PROFILES][MAX_PROFILE_WIDTH], char profile_names[MAX_PROFILES][MAX_PROFILE_WIDTH], int has_sub_profiles[MAX_PROFILES], size_t *mcount, size_t *count) {
+    profile_index_header_t *header = (profile_index_header_t *) index;
+    char *p = (char *) (index + sizeof(profile_index_header_t));
+    for (int i = 0; i < header->manufacturers; i++) {
+        int duplicate = 0;
+        for (int k = 0; k < *mcount; k++) {
+            if (strcmp(p, manufacturer_names[k]) == 0) {
+                duplicate = 1;
+                break;
             }
         }
+        if (duplicate == 0 && *mcount < MAX_PROFILES) {
+            strcpy(manufacturer_names[*mcount], p);
+            (*mcount)++;
+        }
+        p += strlen(p) + 1;
+    }
+    qsort(manufacturer_names, *mcount, sizeof *manufacturer_names, string_compare);
+    for (int i = 0; i < header->profiles && *count < MAX_PROFILES; i++) {
+        int flags = p[0];
+        int sub_count = p[1];
+        p += 2;
+        snprintf(profile_names[*count], MAX_PROFILE_WIDTH, "%s%s", prefix, p);
+        has_sub_profiles[*count] = (flags & PROFILE_INDEX_HAS_SUB) != 0;
+        (*count)++;
+        p += strlen(p) + 1;
+        for (int j = 0; j < sub_count; j++) {
+            p += strlen(p) + 1;
+        }
+    }
+}
+
+void scan_profiles(char *prefix, char manufacturer_names[MAX_PROFILES][MAX_PROFILE_WIDTH], char profile_names[MAX_PROFILES][MAX_PROFILE_WIDTH], int has_sub_profiles[MAX_PROFILES], char *path, size_t *mcount, size_t *count) {
+    char cpld_path[MAX_STRING_SIZE];
+    int initial_count = *count;
+    init_filesystem();
+    uint32_t signature = profile_index_signature(path);
+    uint8_t *index = load_profile_index(path, signature);
+    if (index) {
+        read_profile_index(index, prefix, manufacturer_names, profile_names, has_sub_profiles, mcount, count);
+        log_info("Read %d profiles from %s/%s", (int) (*count - initial_count), path, PROFILE_INDEX_NAME);
+    } else {
+        index = build_profile_index(prefix, manufacturer_names, profile_names, has_sub_profiles, path, mcount, count, signature);
+    }
+    sprintf(cpld_path, "%s/%s", PROFILE_BASE, cpld->name);
+    if (index && strcmp(path, cpld_path) == 0) {
+        free(sub_profile_index);
+        sub_profile_index = index;
+        strcpy(sub_profile_index_path, path);
+    } else {
+        free(index);
     }
     close_filesystem();
 }
 
+// Returns 1 if the sub-profile names of sub_path were found in the index
+static int read_sub_profile_index(char sub_profile_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH], char *path, char *sub_path, size_t *count) {
+    if (!sub_profile_index || strcmp(path, sub_profile_index_path) != 0) {
+        return 0;
+    }
+    profile_index_header_t *header = (profile_index_header_t *) sub_profile_index;
+    char *p = (char *) (sub_profile_index + sizeof(profile_index_header_t));
+    for (int i = 0; i < header->manufacturers; i++) {
+        p += strlen(p) + 1;
+    }
+    for (int i = 0; i < header->profiles; i++) {
+        int sub_count = p[1];
+        p += 2;
+        int match = strcmp(p, sub_path) == 0;
+        p += strlen(p) + 1;
+        for (int j = 0; j < sub_count; j++) {
+            if (match && *count < MAX_SUB_PROFILES) {
+                strcpy(sub_profile_names[(*count)++], p);
+            }
+            p += strlen(p) + 1;
+        }
+        if (match) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-void scan_sub_profiles(char sub_profile_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH], char *sub_path, size_t *count) {
-    FRESULT res;
+void remove_profile_indexes() {
     DIR dir;
     static FILINFO fno;
-    char path[100] = "/Profiles/";
-    strncat(path, cpld->name, 80);
-    strncat(path, "/", 80);
-    strncat(path, sub_path, 80);
+    char fpath[MAX_STRING_SIZE];
     init_filesystem();
-    res = f_opendir(&dir, path);
-    if (res == FR_OK) {
-        for (;;) {
-            res = f_readdir(&dir, &fno);
-            if (res != FR_OK || fno.fname[0] == 0 || *count == MAX_SUB_PROFILES) break;
-            if (!(fno.fattrib & AM_DIR)) {
-                if (fno.fname[0] != '.' && strlen(fno.fname) > 4 && strcmp(fno.fname, DEFAULTTXT_STRING) != 0) {
-                    char* filetype = fno.fname + strlen(fno.fname)-4;
-                    if (strcmp(filetype, ".txt") == 0) {
-                        fno.fname[MAX_PROFILE_WIDTH - 1] = 0;
-                        strcpy(sub_profile_names[*count], fno.fname);
-                        sub_profile_names[*count][strlen(fno.fname) - 4] = 0;
-                        (*count)++;
-                    }
+    if (f_opendir(&dir, PROFILE_BASE) == FR_OK) {
+        while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0) {
+            if (fno.fattrib & AM_DIR) {
+                snprintf(fpath, MAX_STRING_SIZE, "%s/%s/%s", PROFILE_BASE, fno.fname, PROFILE_INDEX_NAME);
+                if (f_unlink(fpath) == FR_OK) {
+                    log_info("Removed %s", fpath);
                 }
             }
         }
         f_closedir(&dir);
-        qsort(sub_profile_names, *count, sizeof *sub_profile_names, string_compare);
     }
     close_filesystem();
 }
 
+void scan_sub_profiles(char sub_profile_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH], char *sub_path, size_t *count) {
+    char path[MAX_STRING_SIZE];
+    sprintf(path, "%s/%s", PROFILE_BASE, cpld->name);
+    if (read_sub_profile_index(sub_profile_names, path, sub_path, count)) {
+        return;
+    }
+    strncat(path, "/", 80);
+    strncat(path, sub_path, 80);
+    init_filesystem();
+    scan_sub_profile_folder(sub_profile_names, path, count);
+    close_filesystem();
+}
+
 void scan_rnames(char names[MAX_NAMES][MAX_NAMES_WIDTH], char *path, char *type, int truncate, size_t *count) {
     FRESULT res;
     DIR dir;
@@ -801,6 +1327,66 @@ int file_save_bin(char *path, char *buffer, unsigned int buffer_size) {
     return result;
 }
 
+// Like file_save_bin but the data is copied and written by a worker core if one is free
+void file_save_background(char *path, char *buffer, unsigned int buffer_size) {
+   io_job_t *job = &io_job;
+
+   init_filesystem();   // also ends any recording before this writes to the card
+
+   uint8_t *copy = get_io_job_buffer(buffer_size);
+   if (copy) {
+      memcpy(copy, buffer, buffer_size);
+      job->type = IO_JOB_FILE;
+      strcpy(job->path, path);
+      job->buffer = (char *) copy;
+      job->length = buffer_size;
+      if (post_io_job()) {
+         log_info("Saving file %s in background", path);
+         return;
+      }
+   }
+   file_save_bin(path, buffer, buffer_size);
+}
+
+// Creates path as a single run of contiguous clusters of at least size bytes, so it can be
+// written with disk_write from *sector onwards without going through FatFS. Returns 0 on failure.
+int file_create_contiguous(char *path, unsigned int size, unsigned int *sector) {
+   FRESULT result;
+   FIL file;
+   char dirpath[MAX_STRING_SIZE];
+   init_filesystem();
+   strcpy(dirpath, path);
+   char *position = strrchr(dirpath, '/');
+   if (position && position != dirpath) {
+      *position = 0;
+      result = f_mkdir(dirpath);
+      if (result != FR_OK && result != FR_EXIST) {
+         log_warn("Failed to create dir %s (result = %d)", dirpath, result);
+      }
+   }
+   result = f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS);
+   if (result != FR_OK) {
+      log_warn("Failed to create %s (result = %d)", path, result);
+      close_filesystem();
+      return 0;
+   }
+   result = f_expand(&file, size, 1);
+   if (result != FR_OK) {
+      log_warn("Failed to allocate %d contiguous bytes for %s (result = %d)", size, path, result);
+      f_close(&file);
+      f_unlink(path);
+      close_filesystem();
+      return 0;
+   }
+   *sector = fsObject.database + fsObject.csize * (file.obj.sclust - 2);
+   result = f_close(&file);
+   if (result != FR_OK) {
+      log_warn("Failed to close %s (result = %d)", path, result);
+   }
+   close_filesystem();
+   return result == FR_OK;
+}
+
 int file_load_raw(char *path, char *buffer, unsigned int buffer_size) {
    FRESULT result;
    FIL file;
@@ -1212,6 +1798,7 @@ int file_save_palette(char *name, char *buffer, unsigned int buffer_size) {
    FIL file;
    unsigned int num_written = 0;
    char path[MAX_STRING_SIZE];
+   init_filesystem();
    result = f_mkdir(PALETTES_BASE);
    if (result != FR_OK && result != FR_EXIST) {
        log_warn("Failed to create dir %s (result = %d)",PALETTES_BASE, result);
@@ -1241,18 +1828,44 @@ int file_save_palette(char *name, char *buffer, unsigned int buffer_size) {
    return 1;
 }
 
-int create_and_scan_palettes(char names[MAX_NAMES][MAX_NAMES_WIDTH], uint32_t palette_array[MAX_NAMES][MAX_PALETTE_ENTRIES]) {
+// Loads MAX_PALETTE_ENTRIES entries, anything missing from the file is left as zero.
+// Returns the number of bytes read, which is zero if there is no readable file.
+int file_load_palette(char *name, uint32_t *entries) {
+   FRESULT result;
+   FIL file;
+   unsigned int bytes_read = 0;
+   char path[MAX_STRING_SIZE];
+   memset(entries, 0, MAX_PALETTE_ENTRIES * sizeof(uint32_t));
+   sprintf(path, "%s/%s%s", PALETTES_BASE, name, PALETTES_TYPE);
+   init_filesystem();
+   log_info("Loading palette %s", path);
+   result = f_open(&file, path, FA_READ);
+   if (result != FR_OK) {
+      log_warn("Failed to open %s (result = %d)", path, result);
+   } else {
+      result = f_read(&file, entries, MAX_PALETTE_ENTRIES * sizeof(uint32_t), &bytes_read);
+      if (result != FR_OK) {
+         log_warn("Failed to read %s (result = %d)", path, result);
+         bytes_read = 0;
+      }
+      f_close(&file);
+   }
+   close_filesystem();
+   return bytes_read;
+}
+
+// names must start with the NUM_PALETTES built in palette names. On return names holds
+// the sorted names of all the palette files plus any built in palette without a file,
+// nothing is loaded or generated until a palette is selected.
+int create_and_scan_palettes(char names[MAX_NAMES][MAX_NAMES_WIDTH]) {
     int count = 0;
-    char path[MAX_STRING_SIZE];
+    static char builtin_names[NUM_PALETTES][MAX_NAMES_WIDTH];
     FRESULT res;
     DIR dir;
     static FILINFO fno;
     init_filesystem();
 
-    for (int i = 0;i < NUM_PALETTES; i++) {
-        file_save_palette((char *) names[i], (char *) palette_array[i], sizeof(palette_array[i]));
-    }
-
+    memcpy(builtin_names, names, sizeof(builtin_names));
     res = f_opendir(&dir, PALETTES_BASE);
     if (res == FR_OK) {
         for (;;) {
@@ -1269,18 +1882,23 @@ int create_and_scan_palettes(char names[MAX_NAMES][MAX_NAMES_WIDTH], uint32_t pa
             }
         }
         f_closedir(&dir);
-        qsort(names, count, sizeof *names, string_compare);
     }
 
-    if (count !=0) {
-      for (int i = 0; i < count; i++) {
-         sprintf(path, "%s/%s%s", PALETTES_BASE, names[i], PALETTES_TYPE);
-         //log_info("READING PALETTE: %s", names[i]);
-         file_load_raw(path, (char*) palette_array[i], sizeof(palette_array[i]));
-      }
-    } else {
-         strcpy(names[0], NOT_FOUND_STRING);
+    // a built in palette is still listed when its file is missing, it is generated when selected
+    int files = count;
+    for (int j = 0; j < NUM_PALETTES && count < MAX_NAMES; j++) {
+        int found = 0;
+        for (int i = 0; i < files; i++) {
+            if (strcmp(names[i], builtin_names[j]) == 0) {
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            strcpy(names[count++], builtin_names[j]);
+        }
     }
+    qsort(names, count, sizeof *names, string_compare);
 
     close_filesystem();
 
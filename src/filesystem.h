@@ -6,8 +6,10 @@
 void init_filesystem();
 void capture_screenshot(capture_info_t *capinfo, char *profile);
 void close_filesystem();
+void filesystem_poll();
 void scan_cpld_filenames(char cpld_filenames[MAX_CPLD_FILENAMES][MAX_FILENAME_WIDTH], char *path, int *count);
 void scan_profiles(char *prefix, char manufacturer_names[MAX_PROFILES][MAX_PROFILE_WIDTH], char profile_names[MAX_PROFILES][MAX_PROFILE_WIDTH], int has_sub_profiles[MAX_PROFILES], char *path, size_t *mcount, size_t *count);
+void remove_profile_indexes();
 void scan_sub_profiles(char sub_profile_names[MAX_SUB_PROFILES][MAX_PROFILE_WIDTH], char *sub_path, size_t *count);
 void write_profile_choice(char *profile_name, int saved_config_number, char* cpld_name);
 unsigned int file_read_profile(char *profile_name, int saved_config_number, char *sub_profile_name, int updatecmd, char *command_string, unsigned int buffer_size);
@@ -16,8 +18,12 @@ int file_save_config(char *resolution_name, int refresh, int scaling, int filter
 int file_load(char *path, char *buffer, unsigned int buffer_size);
 int file_save(char *dirpath, char *name, char *buffer, unsigned int buffer_size, int saved_config_number);
 int file_restore(char *dirpath, char *name, int saved_config_number);
-   int create_and_scan_palettes(char names[MAX_NAMES][MAX_NAMES_WIDTH], uint32_t palette_array[MAX_NAMES][MAX_PALETTE_ENTRIES]);
+   int create_and_scan_palettes(char names[MAX_NAMES][MAX_NAMES_WIDTH]);
+int file_load_palette(char *name, uint32_t *entries);
+int file_save_palette(char *name, char *buffer, unsigned int buffer_size);
 int file_save_bin(char *path, char *buffer, unsigned int buffer_size);
+void file_save_background(char *path, char *buffer, unsigned int buffer_size);
+int file_create_contiguous(char *path, unsigned int size, unsigned int *sector);
 int check_file(char* file_path, char* string);
 int test_file(char* file_path);
 #endif
@@ -723,10 +723,8 @@ void xsvfShiftOnly( long    lNumBits,
 {
     unsigned char*  pucTdi;
     unsigned char*  pucTdo;
-    unsigned char   ucTdiByte;
     unsigned char   ucTdoByte;
-    unsigned char   ucTdoBit;
-    int             i;
+    int             iBits;
 
     /* assert( ( ( lNumBits + 7 ) / 8 ) == plvTdi->len ); */
 
@@ -739,38 +737,16 @@ void xsvfShiftOnly( long    lNumBits,
     }
 
     /* Shift LSB first.  val[N-1] == LSB.  val[0] == MSB. */
+    /* A byte at a time, see shiftBits in ports.c */
     pucTdi  = plvTdi->val + plvTdi->len;
     while ( lNumBits )
     {
-        /* Process on a byte-basis */
-        ucTdiByte   = (*(--pucTdi));
-        ucTdoByte   = 0;
-        for ( i = 0; ( lNumBits && ( i < 8 ) ); ++i )
-        {
-            --lNumBits;
-            if ( iExitShift && !lNumBits )
-            {
-                /* Exit Shift-DR state */
-                setPort( TMS, 1 );
-            }
-
-            /* Set the new TDI value */
-            setPort( TDI, (short)(ucTdiByte & 1) );
-            ucTdiByte   >>= 1;
-
-            /* Set TCK low */
-            setPort( TCK, 0 );
-
-            if ( pucTdo )
-            {
-                /* Save the TDO value */
-                ucTdoBit    = readTDOBit();
-                ucTdoByte   |= ( ucTdoBit << i );
-            }
+        iBits       = ( lNumBits < 8 ) ? (int)lNumBits : 8;
+        lNumBits    -= iBits;
 
-            /* Set TCK high */
-            setPort( TCK, 1 );
-        }
+        /* Exit Shift-DR state with the last bit */
+        ucTdoByte   = shiftBits( *(--pucTdi), iBits,
+                                 ( iExitShift && !lNumBits ) );
 
         /* Save the TDO byte value */
         if ( pucTdo )
@@ -10,44 +10,119 @@
 /*              Add print in setPort for xapp058_example.exe.*/
 /*******************************************************/
 #include <stdio.h>
+#include <stdint.h>
 
 #include "ports.h"
 #include "../defs.h"
+#include "../logging.h"
 #include "../rpi-gpio.h"
+#include "../rpi-systimer.h"
+#include "../startup.h"
 #include "../fatfs/ff.h"
+#include "../info.h"
 #include "../rgb_to_fb.h"
 #include "../rgb_to_hdmi.h"
 
+// TMS and TDI are written together (one GPSET0 and one GPCLR0) as TCK falls, so they have
+// the whole low half of the clock to settle before the CPLD samples them on the rising edge,
+// and TDO, which the CPLD changes on the falling edge, is read just before TCK rises.
+// Each half of the clock is a fixed number of ARM cycles, worked out once by
+// setTckHalfPeriod rather than scaled from the nominal CPU speed on every edge.
+
+#define TCK_MASK (1 << TCK_PIN)
+#define TMS_MASK (1 << TMS_PIN)
+#define TDI_MASK (1 << TDI_PIN)
+
 unsigned char *xsvf_data;
 
+static uint32_t port_state = 0;     // TMS and TDI for the next rising edge of TCK
+static uint32_t port_applied = 0;   // as last written to the pins
+static int half_period = 1000;      // in ARM cycles
+
+// Any supported Pi runs its ARM within this range, a count outside it is a bad measurement
+#define ARM_MHZ_MIN 200
+#define ARM_MHZ_MAX 3000
+
+static unsigned int arm_cycles_per_ms = 0;
+
+static unsigned int measure_arm_cycles_per_ms()
+{
+   rpi_sys_timer_t *timer = RPI_GetSystemTimer();
+   // count ARM cycles over 1ms of the 1MHz system timer, on the counter delay_in_arm_cycles uses
+   uint32_t start = timer->counter_lo;
+   while (timer->counter_lo == start);
+   unsigned int cycles = get_cycle_counter();
+   start = timer->counter_lo;
+   while (timer->counter_lo - start < 1000);
+   cycles = get_cycle_counter() - cycles;
+   if (cycles < ARM_MHZ_MIN * 1000 || cycles > ARM_MHZ_MAX * 1000) {
+      unsigned int nominal = get_clock_rate(ARM_CLK_ID) / 1000000;
+      log_warn("JTAG: measured ARM clock of %dMHz is out of range, using the nominal %dMHz", cycles / 1000, nominal);
+      if (nominal < ARM_MHZ_MIN || nominal > ARM_MHZ_MAX) {
+         return 0;
+      }
+      cycles = nominal * 1000;
+   }
+   return cycles;
+}
+
+int setTckHalfPeriod(int ns)
+{
+   // measured once, so a slower retry after a failure is timed from the same clock
+   if (arm_cycles_per_ms == 0) {
+      arm_cycles_per_ms = measure_arm_cycles_per_ms();
+      if (arm_cycles_per_ms == 0) {
+         return 0;
+      }
+   }
+   half_period = (int) (((uint64_t) arm_cycles_per_ms * ns) / 1000000);
+   log_info("JTAG: TCK half period %dns (%d cycles at %dMHz)", ns, half_period, arm_cycles_per_ms / 1000);
+   return 1;
+}
+
+static inline void apply_port_state()
+{
+   RPI_GpioBase->GPCLR0 = ~port_state & (TMS_MASK | TDI_MASK);
+   RPI_GpioBase->GPSET0 = port_state;
+   port_applied = port_state;
+}
+
+static inline void tck_low()
+{
+   RPI_GpioBase->GPCLR0 = TCK_MASK;
+   apply_port_state();
+   delay_in_arm_cycles(half_period);
+}
+
+static inline void tck_high()
+{
+   if (port_applied != port_state) {
+      // TMS or TDI changed while TCK was low
+      apply_port_state();
+      delay_in_arm_cycles(half_period);
+   }
+   RPI_GpioBase->GPSET0 = TCK_MASK;
+   delay_in_arm_cycles(half_period);
+   RPI_GpioBase->GPCLR0 = TMS_MASK;   //force termination off during reprogramming
+   port_applied &= ~TMS_MASK;
+}
+
 /* setPort:  Implement to set the named JTAG signal (p) to the new value (v).*/
 /* if in debugging mode, then just set the variables */
 void setPort(short p,short val)
 {
-static short TMS_state = 0;
-static short TDI_state = 0;
-
    switch (p) {
    case TMS:
-      //RPI_SetGpioValue(TMS_PIN, val);
-      TMS_state = val;
+      port_state = val ? (port_state | TMS_MASK) : (port_state & ~TMS_MASK);
       break;
    case TDI:
-      //RPI_SetGpioValue(TDI_PIN, val);
-      TDI_state = val;
+      port_state = val ? (port_state | TDI_MASK) : (port_state & ~TDI_MASK);
       break;
    case TCK:
       if (val == 0) {
-          RPI_SetGpioValue(TCK_PIN, 0);
-          delay_in_arm_cycles_cpu_adjust(500);
+         tck_low();
       } else {
-          RPI_SetGpioValue(TMS_PIN, TMS_state);
-          RPI_SetGpioValue(TDI_PIN, TDI_state);
-          delay_in_arm_cycles_cpu_adjust(500);
-          RPI_SetGpioValue(TCK_PIN, 1);
-          delay_in_arm_cycles_cpu_adjust(500);
-          RPI_SetGpioValue(TMS_PIN, 0);  //force termination off during reprogramming
-          delay_in_arm_cycles_cpu_adjust(1000);
+         tck_high();
       }
       break;
    default:
@@ -56,6 +131,24 @@ static short TDI_state = 0;
 
 }
 
+/* shiftBits:  the same sequence as setPort TMS, TDI, TCK 0, readTDOBit, TCK 1 */
+/* for each bit, without a call per signal */
+unsigned char shiftBits(unsigned char tdi, int bits, int exitShift)
+{
+   unsigned char tdo = 0;
+   for (int i = 0; i < bits; i++) {
+      if (exitShift && i == bits - 1) {
+         port_state |= TMS_MASK;
+      }
+      port_state = (tdi & 1) ? (port_state | TDI_MASK) : (port_state & ~TDI_MASK);
+      tdi >>= 1;
+      tck_low();
+      tdo |= ((RPI_GpioBase->GPLEV0 >> TDO_PIN) & 1) << i;
+      tck_high();
+   }
+   return tdo;
+}
+
 
 /* toggle tck LH.  No need to modify this code.  It is output via setPort. */
 void pulseClock()
@@ -76,7 +169,7 @@ void readByte(unsigned char *data)
 /* read the TDO bit from port */
 unsigned char readTDOBit()
 {
-   return RPI_GetGpioValue(TDO_PIN);
+   return (RPI_GpioBase->GPLEV0 >> TDO_PIN) & 1;
 }
 
 /* waitTime:  Implement as follows: */
@@ -90,7 +183,13 @@ unsigned char readTDOBit()
 /*                              requirement is also satisfied.               */
 void waitTime(long microsec)
 {
+    // TCK is much faster than 1MHz, so the count alone is no longer long enough
+    rpi_sys_timer_t *timer = RPI_GetSystemTimer();
+    uint32_t start = timer->counter_lo;
     for (long i = 0; i < microsec; i++) {
         pulseClock();
     }
+    while ((long) (timer->counter_lo - start) < microsec) {
+        pulseClock();
+    }
 }
@@ -28,4 +28,16 @@ extern void readByte(unsigned char *data);
 
 extern void waitTime(long microsec);
 
+/* shift up to 8 bits of tdi LSB first, with TMS high for the last if exitShift */
+/* returns the TDO bits, LSB first */
+extern unsigned char shiftBits(unsigned char tdi, int bits, int exitShift);
+
+/* half period of TCK in ns, the XC9500XL allows a 10MHz TCK */
+#define TCK_HALF_PERIOD_FAST 100
+#define TCK_HALF_PERIOD_SAFE 1250    /* the speed of the original bit banging */
+
+/* set the TCK speed, measures the ARM clock against the system timer */
+/* returns 0 if the ARM clock can't be determined, the TCK speed is then unknown */
+extern int setTckHalfPeriod(int ns);
+
 #endif
@@ -0,0 +1,383 @@
+// xsvfsim.c
+//
+// Host-side XSVF player test
+//
+// Builds jtag/micro.c and jtag/lenval.c for Linux against a software model of
+// the XC9572XL's JTAG port, in place of jtag/ports.c, so the player (and any
+// change to it) can be run against the shipped .xsvf files without hardware.
+//
+// The model:
+//
+// - A full IEEE 1149.1 TAP controller, clocked by the TCK edges the player
+//   produces: TMS and TDI are sampled and the registers shift on the rising
+//   edge, TDO changes on the falling edge.
+//
+// - An 8 bit instruction register, BYPASS, IDCODE and the ISP registers the
+//   Xilinx tools use: ISPEN (6 bits), FERASE / FBULK (18 bits) and
+//   FPGM / FVFY (50 bits: 16 bit address, 32 bits of data, 2 control bits).
+//
+// - Flash memory behind them: an erase clears it, FPGM writes a word, FVFY
+//   reads back the word at the address shifted in by the previous FVFY with
+//   a good status, so a file only verifies if it programmed the same data.
+//
+// A shift that doesn't match the length of the register selected is counted
+// as a protocol error, unless it was resumed through Pause by a retry. TCK is counted and the programming time estimated
+// from the half period given with -p and the run test waits.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ports.h"
+#include "micro.h"
+
+#define IR_LENGTH      8
+
+#define IR_IDCODE      0xFE
+#define IR_BYPASS      0xFF
+#define IR_ISPEN       0xE8
+#define IR_ISPENC      0xE9
+#define IR_FPGM        0xEA
+#define IR_FERASE      0xEC
+#define IR_FBULK       0xED
+#define IR_FVFY        0xEE
+
+#define ISP_STATUS_OK  0x1
+#define FLASH_WORDS    0x10000
+
+#define DEFAULT_IDCODE 0x59604093   // XC9572XL
+
+enum {
+   TLR, RTI,
+   SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+   SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR
+};
+
+// next state for TMS = 0 and TMS = 1
+static const int tap_next[16][2] = {
+   [TLR]        = { RTI,        TLR       },
+   [RTI]        = { RTI,        SELECT_DR },
+   [SELECT_DR]  = { CAPTURE_DR, SELECT_IR },
+   [CAPTURE_DR] = { SHIFT_DR,   EXIT1_DR  },
+   [SHIFT_DR]   = { SHIFT_DR,   EXIT1_DR  },
+   [EXIT1_DR]   = { PAUSE_DR,   UPDATE_DR },
+   [PAUSE_DR]   = { PAUSE_DR,   EXIT2_DR  },
+   [EXIT2_DR]   = { SHIFT_DR,   UPDATE_DR },
+   [UPDATE_DR]  = { RTI,        SELECT_DR },
+   [SELECT_IR]  = { CAPTURE_IR, TLR       },
+   [CAPTURE_IR] = { SHIFT_IR,   EXIT1_IR  },
+   [SHIFT_IR]   = { SHIFT_IR,   EXIT1_IR  },
+   [EXIT1_IR]   = { PAUSE_IR,   UPDATE_IR },
+   [PAUSE_IR]   = { PAUSE_IR,   EXIT2_IR  },
+   [EXIT2_IR]   = { SHIFT_IR,   UPDATE_IR },
+   [UPDATE_IR]  = { RTI,        SELECT_DR },
+};
+
+unsigned char *xsvf_data;
+static unsigned char *xsvf_end;
+
+// Pins
+static int tck = 0;
+static int tms = 0;
+static int tdi = 0;
+static int tdo = 0;
+
+// TAP and registers
+static int tap_state = TLR;
+static int ir = IR_IDCODE;
+static uint64_t shift_reg;
+static int shift_len;
+static int shift_count;
+static int shift_resumed;
+static uint64_t isp_last;           // last value updated into an ISP register
+static uint32_t idcode = DEFAULT_IDCODE;
+static uint32_t *flash;
+
+// Statistics
+static unsigned long long tck_count = 0;
+static unsigned long long wait_clocks = 0;
+static unsigned long long wait_ns = 0;
+static unsigned long shifts = 0;
+static unsigned long retries = 0;
+static unsigned long protocol_errors = 0;
+static unsigned long programmed = 0;
+static unsigned long fault_word = 0;  // flip a bit in this programmed word, 0 for none
+static int half_period_ns = TCK_HALF_PERIOD_FAST;
+static int verbose = 0;
+
+static int dr_length() {
+   switch (ir) {
+   case IR_IDCODE: return 32;
+   case IR_ISPEN:
+   case IR_ISPENC: return 6;
+   case IR_FERASE:
+   case IR_FBULK:  return 18;
+   case IR_FPGM:
+   case IR_FVFY:   return 50;
+   default:        return 1;     // BYPASS, and anything this model doesn't know
+   }
+}
+
+static void capture_dr() {
+   shift_len = dr_length();
+   switch (ir) {
+   case IR_IDCODE:
+      shift_reg = idcode;
+      break;
+   case IR_FERASE:
+   case IR_FBULK:
+   case IR_FPGM:
+      shift_reg = (isp_last & ~3ULL) | ISP_STATUS_OK;
+      break;
+   case IR_FVFY: {
+      uint32_t address = (uint32_t) (isp_last >> 34) & (FLASH_WORDS - 1);
+      shift_reg = ((uint64_t) address << 34) | ((uint64_t) flash[address] << 2) | ISP_STATUS_OK;
+      break;
+   }
+   default:
+      shift_reg = 0;
+      break;
+   }
+}
+
+static void update_dr() {
+   switch (ir) {
+   case IR_FERASE:
+   case IR_FBULK:
+      // only whole device erase is modelled
+      if (shift_reg & 1) {
+         memset(flash, 0xff, FLASH_WORDS * sizeof(uint32_t));
+      }
+      isp_last = shift_reg;
+      break;
+   case IR_FPGM:
+      if (shift_reg & 1) {
+         uint32_t data = (uint32_t) (shift_reg >> 2);
+         if (++programmed == fault_word) {
+            data ^= 1;
+         }
+         flash[(shift_reg >> 34) & (FLASH_WORDS - 1)] = data;
+      }
+      isp_last = shift_reg;
+      break;
+   case IR_FVFY:
+      isp_last = shift_reg;
+      break;
+   default:
+      break;
+   }
+}
+
+static void check_shift(const char *reg) {
+   shifts++;
+   if (shift_count != shift_len && !shift_resumed) {
+      protocol_errors++;
+      if (verbose) {
+         printf("xsvfsim: %d bits shifted into %d bit %s (IR = 0x%02x)\n", shift_count, shift_len, reg, ir);
+      }
+   }
+}
+
+static void tck_rising() {
+   tck_count++;
+   switch (tap_state) {
+   case CAPTURE_DR:
+      capture_dr();
+      shift_count = 0;
+      shift_resumed = 0;
+      break;
+   case CAPTURE_IR:
+      shift_reg = 0x01;             // IEEE 1149.1: the two bits nearest TDO capture 01
+      shift_len = IR_LENGTH;
+      shift_count = 0;
+      shift_resumed = 0;
+      break;
+   case SHIFT_DR:
+   case SHIFT_IR:
+      shift_reg = (shift_reg >> 1) | ((uint64_t) tdi << (shift_len - 1));
+      shift_count++;
+      break;
+   default:
+      break;
+   }
+   int last_state = tap_state;
+   tap_state = tap_next[tap_state][tms];
+   switch (tap_state) {
+   case SHIFT_DR:
+   case SHIFT_IR:
+      // the player's retry goes back in through Pause and shifts an extra bit
+      if (last_state == EXIT2_DR || last_state == EXIT2_IR) {
+         shift_resumed = 1;
+         retries++;
+      }
+      break;
+   case TLR:
+      ir = IR_IDCODE;
+      break;
+   case UPDATE_DR:
+      check_shift("data register");
+      update_dr();
+      break;
+   case UPDATE_IR:
+      check_shift("instruction register");
+      ir = (int) shift_reg;
+      isp_last = 0;
+      break;
+   default:
+      break;
+   }
+}
+
+static void tck_falling() {
+   tdo = (tap_state == SHIFT_DR || tap_state == SHIFT_IR) ? (int) (shift_reg & 1) : 0;
+}
+
+// ports.h
+
+void setPort(short p, short val) {
+   switch (p) {
+   case TMS:
+      tms = val ? 1 : 0;
+      break;
+   case TDI:
+      tdi = val ? 1 : 0;
+      break;
+   case TCK:
+      if (val && !tck) {
+         tck_rising();
+      } else if (!val && tck) {
+         tck_falling();
+      }
+      tck = val ? 1 : 0;
+      break;
+   default:
+      break;
+   }
+}
+
+unsigned char readTDOBit() {
+   return tdo;
+}
+
+void pulseClock() {
+   setPort(TCK, 0);
+   setPort(TCK, 1);
+}
+
+void readByte(unsigned char *data) {
+   // past the end reads as XCOMPLETE
+   *data = (xsvf_data < xsvf_end) ? *xsvf_data++ : 0;
+}
+
+void waitTime(long microsec) {
+   // as jtag/ports.c: at least microsec clocks and at least microsec us
+   for (long i = 0; i < microsec; i++) {
+      pulseClock();
+   }
+   unsigned long long clocks_ns = (unsigned long long) microsec * 2 * half_period_ns;
+   wait_clocks += microsec;
+   wait_ns += (clocks_ns > microsec * 1000ULL) ? clocks_ns : microsec * 1000ULL;
+}
+
+unsigned char shiftBits(unsigned char tdi_bits, int bits, int exitShift) {
+   unsigned char tdo_bits = 0;
+   for (int i = 0; i < bits; i++) {
+      if (exitShift && i == bits - 1) {
+         setPort(TMS, 1);
+      }
+      setPort(TDI, tdi_bits & 1);
+      tdi_bits >>= 1;
+      setPort(TCK, 0);
+      tdo_bits |= readTDOBit() << i;
+      setPort(TCK, 1);
+   }
+   return tdo_bits;
+}
+
+int setTckHalfPeriod(int ns) {
+   half_period_ns = ns;
+   return 1;
+}
+
+// Stand-ins for the firmware functions micro.c calls
+
+void log_info(const char *fmt, ...) {
+   if (verbose) {
+      va_list ap;
+      va_start(ap, fmt);
+      vprintf(fmt, ap);
+      va_end(ap);
+      printf("\n");
+   }
+}
+
+void osd_set_clear(int line, int attr, char *text) {
+   if (verbose) {
+      printf("osd: %s\n", text);
+   }
+}
+
+static void usage() {
+   fprintf(stderr,
+      "usage: xsvfsim [options] file.xsvf\n"
+      "  -i idcode   IDCODE returned by the model (default 0x%08x, XC9572XL)\n"
+      "  -p ns       TCK half period for the time estimate (default %d)\n"
+      "  -f n        flip a bit in the nth word programmed, to check verify fails\n"
+      "  -d level    XSVF player debug level (default 0)\n"
+      "  -v          report protocol errors and player messages\n",
+      DEFAULT_IDCODE, TCK_HALF_PERIOD_FAST);
+   exit(2);
+}
+
+int main(int argc, char **argv) {
+   int opt;
+   xsvf_iDebugLevel = 0;
+   while ((opt = getopt(argc, argv, "i:p:f:d:v")) != -1) {
+      switch (opt) {
+      case 'i': idcode = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case 'p': half_period_ns = atoi(optarg); break;
+      case 'f': fault_word = strtoul(optarg, NULL, 0); break;
+      case 'd': xsvf_iDebugLevel = atoi(optarg); break;
+      case 'v': verbose = 1; break;
+      default: usage();
+      }
+   }
+   if (optind != argc - 1 || half_period_ns <= 0) {
+      usage();
+   }
+
+   FILE *f = fopen(argv[optind], "rb");
+   if (!f) {
+      perror(argv[optind]);
+      return 2;
+   }
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   unsigned char *buffer = malloc(size);
+   flash = malloc(FLASH_WORDS * sizeof(uint32_t));
+   if (!buffer || !flash || fread(buffer, 1, size, f) != (size_t) size) {
+      fprintf(stderr, "xsvfsim: failed to read %s\n", argv[optind]);
+      return 2;
+   }
+   fclose(f);
+   memset(flash, 0xff, FLASH_WORDS * sizeof(uint32_t));
+   xsvf_data = buffer;
+   xsvf_end = buffer + size;
+
+   int result = xsvfExecute();
+
+   double seconds = ((tck_count - wait_clocks) * 2.0 * half_period_ns + wait_ns) * 1e-9;
+   printf("%s: %s, %llu TCK, %lu shifts, %lu retries, %lu words programmed, %lu protocol errors, about %.1fs at %dns\n",
+          argv[optind], result == XSVF_ERROR_NONE ? "ok" : "FAILED", tck_count, shifts, retries, programmed,
+          protocol_errors, seconds, half_period_ns);
+   if (result != XSVF_ERROR_NONE) {
+      printf("xsvfExecute returned %d\n", result);
+   }
+   free(buffer);
+   free(flash);
+   return (result == XSVF_ERROR_NONE && protocol_errors == 0) ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 #include "../logging.h"
 #include "../osd.h"
 #include "../rpi-gpio.h"
+#include "../rpi-systimer.h"
 #include "../rgb_to_fb.h"
 #include "../rgb_to_hdmi.h"
 
@@ -62,7 +63,25 @@ int update_cpld(char *path, int show_message) {
    RPI_SetGpioPinFunction(TDO_PIN, FS_INPUT);
    xsvf_iDebugLevel = 1;
    xsvf_data = xsvf_buffer;
+   if (!setTckHalfPeriod(TCK_HALF_PERIOD_FAST)) {
+      // don't start the erase without knowing how fast TCK will run
+      RPI_SetGpioPinFunction(TDO_PIN, FS_OUTPUT);
+      RPI_SetGpioPinFunction(MUX_PIN,      FS_INPUT);
+      sprintf(message, "Failed, can't measure the ARM clock");
+      log_info(message);
+      osd_set_clear(1, 0, message);
+      return 15;
+   }
+   uint32_t start = RPI_GetSystemTimer()->counter_lo;
    int xsvf_ret = xsvfExecute();
+   if (xsvf_ret != XSVF_ERROR_NONE) {
+      // the file starts with an erase, so it can simply be played again
+      log_warn("Failed at full JTAG speed (error = %d), retrying slower", xsvf_ret);
+      xsvf_data = xsvf_buffer;
+      setTckHalfPeriod(TCK_HALF_PERIOD_SAFE);
+      xsvf_ret = xsvfExecute();
+   }
+   log_info("Programming took %dms", (RPI_GetSystemTimer()->counter_lo - start) / 1000);
    RPI_SetGpioPinFunction(TDO_PIN, FS_OUTPUT);
 
    RPI_SetGpioPinFunction(MUX_PIN,      FS_INPUT);
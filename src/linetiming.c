@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "defs.h"
+#include "info.h"
+#include "logging.h"
+#include "osd.h"
+#include "rgb_to_fb.h"
+#include "linetiming.h"
+
+#ifdef INSTRUMENT_LINES
+
+typedef struct {
+   void *kernel;
+   unsigned int lines;
+   unsigned int worst;
+   uint64_t total;
+   unsigned int histogram[LINE_TIMING_BUCKETS];
+} line_timing_t;
+
+static line_timing_t line_timing[LINE_TIMING_KERNELS];
+static unsigned int line_timing_dropped = 0;
+
+void line_timing_record(unsigned int entry, unsigned int hsync, void *kernel, int flags) {
+   int i;
+   int headroom = (int)(hsync - entry);
+   line_timing_t *lt = line_timing;
+   if (!(flags & BIT_HSYNC_EDGE)) {
+      headroom -= hsync_width;           // kernel returns the trailing edge timestamp
+   }
+   if (headroom < 0) {
+      headroom = 0;
+   }
+   for (i = 0; i < LINE_TIMING_KERNELS && lt->kernel != kernel && lt->kernel != NULL; i++, lt++);
+   if (i == LINE_TIMING_KERNELS) {
+      line_timing_dropped++;
+      return;
+   }
+   if (lt->kernel == NULL) {
+      lt->kernel = kernel;
+      lt->worst = headroom;
+   }
+   if ((unsigned int) headroom < lt->worst) {
+      lt->worst = headroom;
+   }
+   lt->lines++;
+   lt->total += headroom;
+   i = headroom >> LINE_TIMING_BUCKET_SHIFT;
+   lt->histogram[i < LINE_TIMING_BUCKETS ? i : LINE_TIMING_BUCKETS - 1]++;
+}
+
+void line_timing_reset() {
+   memset(line_timing, 0, sizeof(line_timing));
+   line_timing_dropped = 0;
+}
+
+// Headroom that 99% of lines exceed, the lowest bucket boundary below which at most 1% of lines fall
+static unsigned int line_timing_p99(line_timing_t *lt) {
+   unsigned int i;
+   unsigned int count = 0;
+   unsigned int limit = lt->lines / 100;
+   for (i = 0; i < LINE_TIMING_BUCKETS - 1; i++) {
+      count += lt->histogram[i];
+      if (count > limit) {
+         break;
+      }
+   }
+   return i << LINE_TIMING_BUCKET_SHIFT;
+}
+
+static int line_timing_format(line_timing_t *lt, char *buffer) {
+   unsigned int mhz = get_clock_rate(ARM_CLK_ID) / 1000000;
+   unsigned int mean = lt->total / lt->lines;
+   unsigned int p99 = line_timing_p99(lt);
+   if (mhz == 0) {
+      mhz = 1000;
+   }
+   return sprintf(buffer, "%08X %7d %5dns %5dns%s %5dns", (unsigned int) lt->kernel, lt->lines,
+                  lt->worst * 1000 / mhz,
+                  p99 * 1000 / mhz, p99 == ((LINE_TIMING_BUCKETS - 1) << LINE_TIMING_BUCKET_SHIFT) ? "+" : " ",
+                  mean * 1000 / mhz);
+}
+
+void line_timing_log() {
+   int i;
+   char buffer[80];
+   log_info("Capture headroom: kernel, lines, worst, p99, mean");
+   for (i = 0; i < LINE_TIMING_KERNELS && line_timing[i].kernel != NULL; i++) {
+      line_timing_format(&line_timing[i], buffer);
+      log_info("%s", buffer);
+   }
+   if (line_timing_dropped) {
+      log_info("Lines from untracked kernels: %d", line_timing_dropped);
+   }
+}
+
+int line_timing_show(int line) {
+   int i;
+   char buffer[80];
+   osd_set(line++, 0, "  Kernel   Lines  Worst    P99    Mean");
+   for (i = 0; i < LINE_TIMING_KERNELS && line_timing[i].kernel != NULL; i++) {
+      line_timing_format(&line_timing[i], buffer);
+      osd_set(line++, 0, buffer);
+   }
+   if (i == 0) {
+      osd_set(line++, 0, "No lines captured yet");
+   }
+   if (line_timing_dropped) {
+      sprintf(buffer, "Lines from untracked kernels: %d", line_timing_dropped);
+      osd_set(line++, 0, buffer);
+   }
+   return line;
+}
+
+#endif
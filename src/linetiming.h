@@ -0,0 +1,28 @@
+// linetiming.h
+
+#ifndef LINETIMING_H
+#define LINETIMING_H
+
+// Per line capture headroom, only collected when INSTRUMENT_LINES is defined in defs.h
+//
+// Headroom is the time from process_line_loop calling a capture_line kernel to
+// the start of the hsync pulse that kernel was waiting for. Near zero means
+// the loop is only just getting back in time and that profile is close to
+// missing psync edges at the current clock.
+
+#define LINE_TIMING_KERNELS       8
+#define LINE_TIMING_BUCKETS     256
+#define LINE_TIMING_BUCKET_SHIFT  5   // 32 cycles per histogram bucket
+
+// Called from process_line_loop for every captured line
+void line_timing_record(unsigned int entry, unsigned int hsync, void *kernel, int flags);
+
+void line_timing_reset();
+
+// Writes one line of figures per kernel to the log
+void line_timing_log();
+
+// Shows the figures on the OSD starting at line, returns the next free line
+int line_timing_show(int line);
+
+#endif
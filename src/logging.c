@@ -10,7 +10,7 @@ static char log_buffer[BUFFER_LENGTH];
 static int log_pointer = 0;
 
 void log_save(char *filename) {
-    file_save_bin(filename, log_buffer, log_pointer);
+    file_save_background(filename, log_buffer, log_pointer);
 }
 
 #ifdef DEBUG
@@ -14,6 +14,7 @@
 #include "rpi-gpio.h"
 #include "rpi-mailbox.h"
 #include "rpi-mailbox-interface.h"
+#include "rpi-dma.h"
 #include "saa5050_font.h"
 #include "8x8_font.h"
 #include "rgb_to_fb.h"
@@ -23,6 +24,8 @@
 #include "jtag/update_cpld.h"
 #include "startup.h"
 #include "vid_cga_comp.h"
+#include "linetiming.h"
+#include "recording.h"
 #include <math.h>
 
 // =============================================================
@@ -169,6 +172,12 @@ static const char *deinterlace_names[] = {
    "Advanced Motion"
 };
 
+static const char *normal_deinterlace_names[] = {
+   "Weave",
+   "Simple Bob",
+   "Motion Adaptive"
+};
+
 #ifdef MULTI_BUFFER
 static const char *nbuffer_names[] = {
    "1",
@@ -483,7 +492,12 @@ static void info_cal_detail(int line);
 static void info_cal_raw(int line);
 static void info_save_list(int line);
 static void info_save_log(int line);
+static void info_rebuild_profiles(int line);
+static void info_record_fields(int line);
 static void info_credits(int line);
+#ifdef INSTRUMENT_LINES
+static void info_line_timing(int line);
+#endif
 static void info_reboot(int line);
 
 static void info_test_50hz(int line);
@@ -506,7 +520,12 @@ static info_menu_item_t cal_detail_ref       = { I_INFO, "Calibration Detail",
 static info_menu_item_t cal_raw_ref          = { I_INFO, "Calibration Raw",     info_cal_raw};
 static info_menu_item_t save_list_ref        = { I_INFO, "Save Profile List",   info_save_list};
 static info_menu_item_t save_log_ref         = { I_INFO, "Save Log & EDID",     info_save_log};
+static info_menu_item_t rebuild_profiles_ref = { I_INFO, "Rebuild Profile List",info_rebuild_profiles};
+static info_menu_item_t record_fields_ref    = { I_INFO, "Record Fields",       info_record_fields};
 static info_menu_item_t credits_ref          = { I_INFO, "Credits",             info_credits};
+#ifdef INSTRUMENT_LINES
+static info_menu_item_t line_timing_ref      = { I_INFO, "Capture Headroom",    info_line_timing};
+#endif
 static info_menu_item_t reboot_ref           = { I_INFO, "Reboot",              info_reboot};
 
 static back_menu_item_t back_ref             = { I_BACK, "Return"};
@@ -700,6 +719,9 @@ static menu_t info_menu = {
       (base_menu_item_t *) &cal_summary_ref,
       (base_menu_item_t *) &cal_detail_ref,
       (base_menu_item_t *) &cal_raw_ref,
+#ifdef INSTRUMENT_LINES
+      (base_menu_item_t *) &line_timing_ref,
+#endif
       (base_menu_item_t *) &help_buttons_ref,
       (base_menu_item_t *) &help_calibration_ref,
       (base_menu_item_t *) &help_artifacts_ref,
@@ -707,7 +729,9 @@ static menu_t info_menu = {
       (base_menu_item_t *) &help_noise_ref,
       (base_menu_item_t *) &help_updates_ref,
       (base_menu_item_t *) &save_list_ref,
+      (base_menu_item_t *) &rebuild_profiles_ref,
       (base_menu_item_t *) &save_log_ref,
+      (base_menu_item_t *) &record_fields_ref,
       (base_menu_item_t *) &credits_ref,
 #ifndef HIDE_INTERFACE_SETTING
       (base_menu_item_t *) &frontend_ref,
@@ -1063,9 +1087,14 @@ static uint32_t osd_palette_data[256];
 //static unsigned char equivalence[256];
 
 static char palette_names[MAX_NAMES][MAX_NAMES_WIDTH];
-static uint32_t palette_array[MAX_NAMES][MAX_PALETTE_ENTRIES];
 static int ntsc_palette = 0;
 
+// Only the palettes actually selected are loaded (or generated), the last few are kept
+#define PALETTE_CACHE_SIZE 4
+static uint32_t palette_cache[PALETTE_CACHE_SIZE][MAX_PALETTE_ENTRIES];
+static int palette_cache_index[PALETTE_CACHE_SIZE];   // palette number + 1, 0 if empty
+static int palette_cache_next = 0;
+
 static int inhibit_palette_dimming = 0;
 static int single_button_mode = 0;
 static int manufacturer_count = 0;
@@ -1437,8 +1466,9 @@ static const char *get_param_string(param_menu_item_t *param_item) {
       case F_AUTO_SWITCH:
          return autoswitch_names[value];
       case F_MODE7_DEINTERLACE:
-      case F_NORMAL_DEINTERLACE:
          return deinterlace_names[value];
+      case F_NORMAL_DEINTERLACE:
+         return normal_deinterlace_names[value];
       case F_MODE7_SCALING:
          return even_scaling_names[value];
       case F_NORMAL_SCALING:
@@ -1840,12 +1870,29 @@ unsigned int ptr = 0;
     osd_set(line++, 0, "SD card as: 'Profile_List.txt'");
 }
 
+static void info_rebuild_profiles(int line) {
+   // the profile folders are walked again on the next boot
+   remove_profile_indexes();
+   reboot();
+}
+
 static void info_save_log(int line) {
+#ifdef INSTRUMENT_LINES
+   line_timing_log();
+#endif
    log_save("/Log.txt");
    file_save_bin("/EDID.bin", EDID_buf, EDID_bufptr);
    osd_set(line++, 0, "Log.txt and EDID.bin saved to SD card");
 }
 
+static void info_record_fields(int line) {
+   // selecting the page again while recording just shows progress
+   if (recording_start(capinfo, RECORD_FIELDS)) {
+      osd_set(line++, 0, "Recording fields to SD card");
+   }
+   recording_show(line);
+}
+
 static void info_test_50hz(int line) {
 static char osdline[256];
 static int old_50hz_state = 0;
@@ -1898,6 +1945,13 @@ static void info_source_summary(int line) {
    line = show_detected_status(line);
 }
 
+#ifdef INSTRUMENT_LINES
+static void info_line_timing(int line) {
+   osd_set(line++, 0, "Time from capture call to hsync per line");
+   line_timing_show(line);
+}
+#endif
+
 static void info_cal_summary(int line) {
    if (cpld->show_cal_summary) {
       line = cpld->show_cal_summary(line);
@@ -2255,39 +2309,69 @@ double gamma_correct(double value, double normalised_gamma) {
     return value;
 }
 
+// The tint, saturation, contrast, brightness and gamma settings, converted once per palette
+// update by palette_adjust_setup rather than for every entry
+static int adjust_enabled = 0;
+static double adjust_contrast;
+static double adjust_brightness;
+static double adjust_saturation;
+static double adjust_gamma;
+static double adjust_cos;
+static double adjust_sin;
+
+// Colours already adjusted in this update, palettes repeat the same few colours a lot
+#define ADJUST_MEMO_SIZE 64
+static uint32_t adjust_memo_in[ADJUST_MEMO_SIZE];
+static uint32_t adjust_memo_out[ADJUST_MEMO_SIZE];
+static uint8_t adjust_memo_valid[ADJUST_MEMO_SIZE];
+
+static void palette_adjust_setup() {
+    adjust_enabled = get_parameter(F_TINT) !=0 || get_parameter(F_SAT) != 100 || get_parameter(F_CONT) != 100 || get_parameter(F_BRIGHT) != 100 || get_parameter(F_GAMMA) != 100;
+    adjust_contrast = (double)get_parameter(F_CONT) / 100;
+    adjust_brightness = (double)get_parameter(F_BRIGHT) / 200 - 0.5f;
+    adjust_saturation = (double)get_parameter(F_SAT) / 100;
+    adjust_gamma = 1 / ((double)get_parameter(F_GAMMA) / 100);
+    double hue = get_parameter(F_TINT) * PI / 180.0f;
+    adjust_cos = cos(hue);
+    adjust_sin = sin(hue);
+    memset(adjust_memo_valid, 0, sizeof(adjust_memo_valid));
+}
+
 int adjust_palette(int palette) {
-    if (get_parameter(F_TINT) !=0 || get_parameter(F_SAT) != 100 || get_parameter(F_CONT) != 100 || get_parameter(F_BRIGHT) != 100 || get_parameter(F_GAMMA) != 100) {
+    if (adjust_enabled) {
+        int slot = ((uint32_t) palette * 2654435761u) >> 26;
+        if (adjust_memo_valid[slot] && adjust_memo_in[slot] == (uint32_t) palette) {
+            return adjust_memo_out[slot];
+        }
         double R = (double)(palette & 0xff) / 255;
         double G = (double)((palette >> 8) & 0xff) / 255;
         double B = (double)((palette >> 16) & 0xff) / 255;
         double M = (double)((palette >> 24) & 0xff) / 255;
 
-        double normalised_contrast = (double)get_parameter(F_CONT) / 100;
-        double normalised_brightness = (double)get_parameter(F_BRIGHT) / 200 - 0.5f;
-        double normalised_saturation = (double)get_parameter(F_SAT) / 100;
-        double normalised_gamma = 1 / ((double)get_parameter(F_GAMMA) / 100);
-
         double Y = 0.299 * R + 0.587 * G + 0.114 * B;
         double U = -0.14713 * R - 0.28886 * G + 0.436 * B;
         double V = 0.615 * R - 0.51499 * G - 0.10001 * B;
 
-        Y = (Y + normalised_brightness) * normalised_contrast;
-        double hue = get_parameter(F_TINT) * PI / 180.0f;
-        double U2 = (U * cos(hue) + V * sin(hue)) * normalised_saturation * normalised_contrast;
-        double V2 = (V * cos(hue) - U * sin(hue)) * normalised_saturation * normalised_contrast;
+        Y = (Y + adjust_brightness) * adjust_contrast;
+        double U2 = (U * adjust_cos + V * adjust_sin) * adjust_saturation * adjust_contrast;
+        double V2 = (V * adjust_cos - U * adjust_sin) * adjust_saturation * adjust_contrast;
 
-        M = (M + normalised_brightness) * normalised_contrast;
+        M = (M + adjust_brightness) * adjust_contrast;
 
         R = (Y + 1.140 * V2);
         G = (Y - 0.396 * U2 - 0.581 * V2);
         B = (Y + 2.029 * U2);
 
-        R = gamma_correct(R, normalised_gamma);
-        G = gamma_correct(G, normalised_gamma);
-        B = gamma_correct(B, normalised_gamma);
-        M = gamma_correct(M, normalised_gamma);
+        R = gamma_correct(R, adjust_gamma);
+        G = gamma_correct(G, adjust_gamma);
+        B = gamma_correct(B, adjust_gamma);
+        M = gamma_correct(M, adjust_gamma);
 
-        return (int)R | ((int)G << 8) | ((int)B << 16) | ((int)M << 24);
+        int adjusted = (int)R | ((int)G << 8) | ((int)B << 16) | ((int)M << 24);
+        adjust_memo_in[slot] = palette;
+        adjust_memo_out[slot] = adjusted;
+        adjust_memo_valid[slot] = 1;
+        return adjusted;
     } else {
         return (palette);
     }
@@ -2346,6 +2430,36 @@ int colodore_gamma_correct(double value) {
     *mono = colodore_gamma_correct(y);
 }
 
+static void generate_palette(int selected, uint32_t *entries);
+
+// Loading a palette ends any recording (see init_filesystem), which only happens when a
+// palette not used recently is selected
+static uint32_t *get_palette(int palette) {
+    for (int i = 0; i < PALETTE_CACHE_SIZE; i++) {
+        if (palette_cache_index[i] == palette + 1) {
+            return palette_cache[i];
+        }
+    }
+    // replace the oldest, but never the selected or NTSC artifact palette as they are used together
+    int slot = palette_cache_next;
+    while (palette_cache_index[slot] == ntsc_palette + 1 || palette_cache_index[slot] == get_parameter(F_PALETTE) + 1) {
+        slot = (slot + 1) % PALETTE_CACHE_SIZE;
+    }
+    palette_cache_next = (slot + 1) % PALETTE_CACHE_SIZE;
+    if (file_load_palette(palette_names[palette], palette_cache[slot]) == 0) {
+        // a built in palette without a readable file is generated, and saved so it can be edited
+        for (int i = 0; i < NUM_PALETTES; i++) {
+            if (strcmp(palette_names[palette], default_palette_names[i]) == 0) {
+                generate_palette(i, palette_cache[slot]);
+                file_save_palette(palette_names[palette], (char *) palette_cache[slot], sizeof(palette_cache[slot]));
+                break;
+            }
+        }
+    }
+    palette_cache_index[slot] = palette + 1;
+    return palette_cache[slot];
+}
+
 int create_NTSC_artifact_colours(int index, int filtered_bitcount) {
     int colour = index & 0x0f;
     int bitcount = 0;
@@ -2363,7 +2477,7 @@ int create_NTSC_artifact_colours(int index, int filtered_bitcount) {
 
     if (ntsc_palette <= features[F_PALETTE].max) {
         if (colour > 7) colour += 8;
-        int RGBY = palette_array[ntsc_palette][colour];
+        int RGBY = get_palette(ntsc_palette)[colour];
         //if (colour < 0x18) log_info("Using %d, %x for NTSC palette %X",ntsc_palette,colour,  RGBY);
         R = (double)(RGBY & 0xff) / 255.0f;
         G = (double)((RGBY >> 8) & 0xff) / 255.0f;
@@ -2646,7 +2760,8 @@ void yuv2rgb(int maxdesat, int mindesat, int luma_scale, int blank_ref, int y1_m
 }
 
 
-void generate_palettes() {
+// Computes one of the built in palettes, only needed when its file in /Palettes is missing or unreadable
+static void generate_palette(int selected, uint32_t *entries) {
 
 #define bp  0x24    // b-y plus
 #define bz  0x20    // b-y zero
@@ -2661,6 +2776,9 @@ int max_palette_count;
 int luma_palette;
 
     for(int palette = 0; palette < NUM_PALETTES; palette++) {
+        if (palette != selected) {
+            continue;
+        }
         max_palette_count = 64;  //default
         luma_palette = 0;
         for (int i = 0; i < 256; i++) {
@@ -4454,10 +4572,9 @@ int luma_palette;
                 }
             }
 
-            palette_array[palette][i] = (m << 24) | (b << 16) | (g << 8) | r;
+            entries[i] = (m << 24) | (b << 16) | (g << 8) | r;
         }
-        palette_array[palette][MAX_PALETTE_ENTRIES - 1] = max_palette_count;
-        strncpy(palette_names[palette], default_palette_names[palette], MAX_NAMES_WIDTH);
+        entries[MAX_PALETTE_ENTRIES - 1] = max_palette_count;
     }
 
 }
@@ -4470,36 +4587,64 @@ int get_inhibit_palette_dimming16() {
     }
 }
 
+// What the hardware palette holds, so only the entries that differ are sent to it
+static uint32_t hw_palette[256];
+static int hw_palette_colours = 0;
+
+static void write_hw_palette(uint32_t *data, int num_colours) {
+    int first = 0;
+    int last = num_colours - 1;
+    if (num_colours == hw_palette_colours) {
+        while (first < num_colours && data[first] == hw_palette[first]) {
+            first++;
+        }
+        if (first == num_colours) {
+            return;
+        }
+        while (data[last] == hw_palette[last]) {
+            last--;
+        }
+    }
+    memcpy(hw_palette + first, data + first, (last - first + 1) * sizeof(uint32_t));
+    hw_palette_colours = num_colours;
+    RPI_PropertyInit();
+    RPI_PropertyAddTag(TAG_SET_PALETTE, first, last - first + 1, data + first);
+    RPI_PropertyProcess();
+}
+
+void osd_invalidate_palette() {
+    hw_palette_colours = 0;
+}
+
 void osd_write_palette(int new_active) {
     if (capinfo->bpp < 16) {
         if (new_active != old_active) {
             old_active = new_active;
             int num_colours = (capinfo->bpp == 8) ? 256 : 16;
-            RPI_PropertyInit();
             if (new_active != 0) {
-                RPI_PropertyAddTag(TAG_SET_PALETTE, num_colours, osd_palette_data);
+                write_hw_palette(osd_palette_data, num_colours);
             } else {
-                RPI_PropertyAddTag(TAG_SET_PALETTE, num_colours, palette_data);
+                write_hw_palette(palette_data, num_colours);
             }
-            RPI_PropertyProcess();
             //log_info("***Palette change %d", new_active);
         }
     }
 }
 
-void osd_update_palette() {
-    int r = 0;
-    int g = 0;
-    int b = 0;
-    int m = 0;
-    int num_colours = (capinfo->bpp >= 8) ? 256 : 16;
-    int design_type = (cpld->get_version() >> VERSION_DESIGN_BIT) & 0x0F;
-    int max_palette_count = palette_array[get_parameter(F_PALETTE)][MAX_PALETTE_ENTRIES - 1];
-
-    //copy selected palette to current palette, translating for Atom cpld and inverted Y setting (required for 6847 direct Y connection)
-
-    for (int i = 0; i < num_colours; i++) {
-
+// Which entry of the selected palette each frame buffer value shows (before any Y inversion),
+// only rebuilt when the capture format or CPLD design changes. This is the lookup table for
+// the 9/12 bit to 8bpp bit reorder and the Atom colour mapping, so osd_update_palette does
+// one load per entry instead of the bit shuffling.
+static uint8_t palette_map[256];
+static int palette_map_key = -1;
+
+static void update_palette_map(int design_type) {
+    int key = (capinfo->bpp << 16) | (capinfo->sample_width << 8) | design_type;
+    if (key == palette_map_key) {
+        return;
+    }
+    palette_map_key = key;
+    for (int i = 0; i < 256; i++) {
         int i_adj = i;
         if (capinfo->bpp == 8 && capinfo->sample_width >= SAMPLE_WIDTH_9LO) {
             //if capturing 9 or 12bpp to an 8bpp frame buffer bits are captured in the wrong order so rearrange the palette order to match
@@ -4544,27 +4689,53 @@ void osd_update_palette() {
             }
         }
 
+        palette_map[i] = i_adj;
+    }
+}
 
-        if (((get_parameter(F_PALETTE_CONTROL) == PALETTECONTROL_NTSCARTIFACT_CGA && get_parameter(F_NTSC_COLOUR) != 0)
+void osd_update_palette() {
+    int r = 0;
+    int g = 0;
+    int b = 0;
+    int m = 0;
+    int num_colours = (capinfo->bpp >= 8) ? 256 : 16;
+    int design_type = (cpld->get_version() >> VERSION_DESIGN_BIT) & 0x0F;
+    uint32_t *palette = get_palette(get_parameter(F_PALETTE));
+    int max_palette_count = palette[MAX_PALETTE_ENTRIES - 1];
+
+    //copy selected palette to current palette, translating for Atom cpld and inverted Y setting (required for 6847 direct Y connection)
+
+    update_palette_map(design_type);
+    int ntsc_artifact = ((get_parameter(F_PALETTE_CONTROL) == PALETTECONTROL_NTSCARTIFACT_CGA && get_parameter(F_NTSC_COLOUR) != 0)
           || (get_parameter(F_PALETTE_CONTROL) == PALETTECONTROL_NTSCARTIFACT_BW)
           || (get_parameter(F_PALETTE_CONTROL) == PALETTECONTROL_NTSCARTIFACT_BW_AUTO))
-          && capinfo->bpp == 8 && capinfo->sample_width <= SAMPLE_WIDTH_6) {
+          && capinfo->bpp == 8 && capinfo->sample_width <= SAMPLE_WIDTH_6;
+    int invert_y = (get_feature(F_OUTPUT_INVERT) == INVERT_Y) ? 0x12 : 0;
+    palette_adjust_setup();
+
+    for (int i = 0; i < num_colours; i++) {
+        if (ntsc_artifact) {
             max_palette_count = 128;
             if ((i & 0x7f) < 0x40) {
                 if (get_parameter(F_PALETTE_CONTROL) == PALETTECONTROL_NTSCARTIFACT_CGA) {
+                    if (i >= 0x80) {
+                        palette_data[i] = palette_data[i - 0x80];   // only depends on i & 0x7f
+                        continue;
+                    }
                     palette_data[i] = create_NTSC_artifact_colours_palette_320(i & 0x7f);
                 } else {
-                    palette_data[i] = palette_array[get_parameter(F_PALETTE)][i_adj];
+                    palette_data[i] = palette[palette_map[i]];
                 }
             } else {
+                if (i >= 0x80) {
+                    palette_data[i] = palette_data[i - 0x80];       // only depends on i & 0x3f
+                    continue;
+                }
                 int filtered_bitcount = ((i & 0x3f) >> 4) + 1;
                 palette_data[i] = create_NTSC_artifact_colours(i & 0x3f, filtered_bitcount);
             }
         } else {
-            if (get_feature(F_OUTPUT_INVERT) == INVERT_Y) {
-                i_adj ^= 0x12;
-            }
-            palette_data[i] = palette_array[get_parameter(F_PALETTE)][i_adj];
+            palette_data[i] = palette[palette_map[i] ^ invert_y];
         }
         palette_data[i] = adjust_palette(palette_data[i]);
     }
@@ -4663,13 +4834,11 @@ void osd_update_palette() {
     }
 
     if (capinfo->bpp < 16) {
-        RPI_PropertyInit();
         if (active) {
-            RPI_PropertyAddTag(TAG_SET_PALETTE, num_colours, osd_palette_data);
+            write_hw_palette(osd_palette_data, num_colours);
         } else {
-            RPI_PropertyAddTag(TAG_SET_PALETTE, num_colours, palette_data);
+            write_hw_palette(palette_data, num_colours);
         }
-        RPI_PropertyProcess();
         old_active = active;
     }
 }
@@ -6321,8 +6490,10 @@ void osd_init() {
    sdram_clock = get_clock_rate(SDRAM_CLK_ID)/1000000;
    set_clock_rate_sdram(sdram_clock * 1000000);
 
-   generate_palettes();
-   features[F_PALETTE].max  = create_and_scan_palettes(palette_names, palette_array) - 1;
+   for (int i = 0; i < NUM_PALETTES; i++) {
+      strncpy(palette_names[i], default_palette_names[i], MAX_NAMES_WIDTH);
+   }
+   features[F_PALETTE].max  = create_and_scan_palettes(palette_names) - 1;
 
    for (ntsc_palette = 0; ntsc_palette <= features[F_PALETTE].max; ntsc_palette++) {
         if (strcmp(palette_names[ntsc_palette], default_palette_names[PALETTE_XRGB]) == 0) {
@@ -6792,6 +6963,8 @@ void osd_update(uint32_t *osd_base, int bytes_per_line, int relocate) {
    if (!active) {
       return;
    }
+   // a clear may still be running in the background
+   RPI_DMA_Wait();
 
 #if defined(USE_CACHED_SCREEN )
    if (capinfo->video_type == VIDEO_TELETEXT && relocate) {
@@ -6800,8 +6973,9 @@ void osd_update(uint32_t *osd_base, int bytes_per_line, int relocate) {
 #endif
 
    if (capinfo->bpp == 16) {
-       if (capinfo->video_type == VIDEO_INTERLACED && (capinfo->sync_type & SYNC_BIT_INTERLACED) && get_parameter(F_NORMAL_DEINTERLACE) == DEINTERLACE_NONE) {
+       if (capinfo->video_type == VIDEO_INTERLACED && (capinfo->sync_type & SYNC_BIT_INTERLACED) && get_parameter(F_NORMAL_DEINTERLACE) != DEINTERLACE_BOB) {
            clear_full_screen();
+           RPI_DMA_Wait();
        }
    }
 
@@ -7028,8 +7202,11 @@ void __attribute__ ((aligned (64))) osd_update_fast(uint32_t *osd_base, int byte
    if (!active) {
       return;
    }
-   if (capinfo->bpp == 16 && capinfo->video_type == VIDEO_INTERLACED && (capinfo->detected_sync_type & SYNC_BIT_INTERLACED) && get_parameter(F_NORMAL_DEINTERLACE) == DEINTERLACE_NONE) {
+   // a clear started on loss of sync in this field may still be running
+   RPI_DMA_Wait();
+   if (capinfo->bpp == 16 && capinfo->video_type == VIDEO_INTERLACED && (capinfo->detected_sync_type & SYNC_BIT_INTERLACED) && get_parameter(F_NORMAL_DEINTERLACE) != DEINTERLACE_BOB) {
       clear_screen();
+      RPI_DMA_Wait();
    }
    // SAA5050 character data is 12x20
    int bufferCharWidth = (capinfo->chars_per_line << 3) / 12;         // SAA5050 character data is 12x20
@@ -1,6 +1,8 @@
 #ifndef OSD_H
 #define OSD_H
 
+#include <stdint.h>
+
 #define OSD_SW1     1
 #define OSD_SW2     2
 #define OSD_SW3     3
@@ -131,6 +133,7 @@ enum {
 enum {
    DEINTERLACE_NONE,
    DEINTERLACE_BOB,
+   DEINTERLACE_MOTION,
    NUM_DEINTERLACES
 };
 
@@ -296,6 +299,7 @@ int  osd_active();
 int menu_active();
 int  osd_key(int key);
 void osd_update_palette();
+void osd_invalidate_palette();
 void process_profile(int profile_number);
 void process_sub_profile(int profile_number, int sub_profile_number);
 void load_profiles(int profile_number, int save_selected);
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "defs.h"
+#include "logging.h"
+#include "osd.h"
+#include "filesystem.h"
+#include "rgb_to_fb.h"
+#include "rgb_to_hdmi.h"
+#include "startup.h"
+#include "rpi-systimer.h"
+#include "fatfs/ff.h"
+#include "fatfs/diskio.h"
+#include "recording.h"
+
+// The capture core only fills in the header and hands each field to a worker core
+// (field_job_function runs between the last line of one field and the next vsync).
+// The worker copies the page into one of two buffers, which stays ahead of the next
+// field being drawn over it, then writes the whole record with one multi-sector
+// disk_write. Records reach the card in field order, so while one worker is writing
+// the next can already be copying into the other buffer.
+//
+// Interlaced sources are woven into the same page, so while the worker copies it the
+// next field is already being drawn over the lines of the other field. Only the lines
+// of the field recorded in the header flags are known to be complete (see recording.h).
+
+#define RECORD_BASE    "/Recordings"
+#define RECORD_BUFFERS 2
+#define RECORD_ALIGN   4096   // page aligned, so the copy into the card driver's bounce buffer is fast
+
+static uint8_t *record_allocation = NULL;
+static unsigned int record_allocation_size = 0;
+static uint8_t *record_buffer[RECORD_BUFFERS];
+static volatile int record_buffer_busy[RECORD_BUFFERS];
+static volatile int record_written = 0;   // records on the card, advanced by the workers
+static int record_errors = 0;             // only changed by the worker holding the card
+static int record_fields = 0;
+static int record_taken = 0;              // fields handed to a worker core
+static int record_dropped = 0;
+static int record_active = 0;             // set from start until the result is reported
+static unsigned int record_sector;
+static record_header_t record_template;
+static char record_path[MAX_STRING_SIZE];
+static char record_status[MAX_STRING_SIZE] = "No recording made";
+
+static void record_write_job(int buffer, int page, int field, int arg3) {
+   uint8_t *data = record_buffer[buffer];
+   int sectors = record_template.record_size / RECORD_SECTOR_SIZE;
+   memcpy(data + RECORD_HEADER_SIZE, (uint8_t *) page, record_template.data_size);
+   while (record_written != field);
+   __data_memory_barrier();
+   if (disk_write(0, data, record_sector + field * sectors, sectors) != RES_OK) {
+      record_errors++;
+   }
+   __data_memory_barrier();
+   record_buffer_busy[buffer] = 0;
+   record_written = field + 1;
+}
+
+static void record_field(uint8_t *page, int flags) {
+   int buffer = record_taken % RECORD_BUFFERS;
+   if (record_buffer_busy[buffer]) {
+      record_dropped++;
+      return;
+   }
+   record_header_t *header = (record_header_t *) record_buffer[buffer];
+   memcpy(header, &record_template, sizeof(record_header_t));
+   header->field = record_taken;
+   header->dropped = record_dropped;
+   header->flags = flags;
+   header->timestamp = get_cycle_counter();
+   header->hsync_period = total_hsync_period;
+   header->vsync_period = vsync_period;
+   record_buffer_busy[buffer] = 1;
+   if (post_core_job(record_write_job, buffer, (int) page, record_taken, 0) == 0) {
+      record_buffer_busy[buffer] = 0;
+      record_dropped++;
+      return;
+   }
+   record_taken++;
+   if (record_taken == record_fields) {
+      field_job_function = NULL;
+   }
+}
+
+static void record_report() {
+   unsigned int suppressed = disk_take_suppressed_messages();
+   if (suppressed) {
+      log_warn("%d SD card messages from the worker cores were not shown", suppressed);
+   }
+   sprintf(record_status, "%d fields, %d dropped, %d errors", record_taken, record_dropped, record_errors);
+   log_info("Recorded %s to %s", record_status, record_path);
+   record_active = 0;
+}
+
+int recording_start(capture_info_t *capinfo, int nfields) {
+   if (record_active) {
+      return 0;
+   }
+   if (get_worker_cores() == 0) {
+      sprintf(record_status, "Recording needs a worker core");
+      log_warn("%s", record_status);
+      return 0;
+   }
+
+   unsigned int data_size = capinfo->pitch * capinfo->height;
+   unsigned int record_size = (RECORD_HEADER_SIZE + data_size + RECORD_SECTOR_SIZE - 1) & ~(RECORD_SECTOR_SIZE - 1);
+   unsigned int stride = (record_size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+   if (stride * RECORD_BUFFERS + RECORD_ALIGN > record_allocation_size) {
+      free(record_allocation);
+      record_allocation = malloc(stride * RECORD_BUFFERS + RECORD_ALIGN);
+      record_allocation_size = record_allocation ? stride * RECORD_BUFFERS + RECORD_ALIGN : 0;
+      if (!record_allocation) {
+         sprintf(record_status, "No memory for recording buffers");
+         log_warn("%s", record_status);
+         return 0;
+      }
+   }
+   uint8_t *base = (uint8_t *) (((uintptr_t) record_allocation + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1));
+   for (int i = 0; i < RECORD_BUFFERS; i++) {
+      record_buffer[i] = base + i * stride;
+      record_buffer_busy[i] = 0;
+   }
+
+   int id = 0;
+   do {
+      sprintf(record_path, "%s/record%d.raw", RECORD_BASE, id++);
+   } while (test_file(record_path));
+   if (!file_create_contiguous(record_path, record_size * nfields, &record_sector)) {
+      sprintf(record_status, "Failed to create %s", record_path);
+      return 0;
+   }
+
+   record_header_t *t = &record_template;
+   memset(t, 0, sizeof(record_header_t));
+   t->magic = RECORD_MAGIC;
+   t->header_size = RECORD_HEADER_SIZE;
+   t->record_size = record_size;
+   t->data_size = data_size;
+   // differs between recordings, so records left over from an older file in reused clusters are rejected
+   t->session = RPI_GetSystemTimer()->counter_lo ^ ((id - 1) << 24);
+   t->fields = nfields;
+   t->pitch = capinfo->pitch;
+   t->width = capinfo->width;
+   t->height = capinfo->height;
+   t->sizex2 = capinfo->sizex2;
+   t->bpp = capinfo->bpp;
+   t->chars_per_line = capinfo->chars_per_line;
+   t->nlines = capinfo->nlines;
+   t->h_offset = capinfo->h_offset;
+   t->v_offset = capinfo->v_offset;
+   t->palette_control = capinfo->palette_control;
+   t->sample_width = capinfo->sample_width;
+   t->h_adjust = capinfo->h_adjust;
+   t->v_adjust = capinfo->v_adjust;
+   t->sync_type = capinfo->sync_type;
+   t->detected_sync_type = capinfo->detected_sync_type;
+   t->vsync_type = capinfo->vsync_type;
+   t->video_type = capinfo->video_type;
+   t->ntscphase = capinfo->ntscphase;
+   t->border = capinfo->border;
+   t->delay = capinfo->delay;
+   t->mode7 = capinfo->mode7;
+   t->px_sampling = capinfo->px_sampling;
+   if (capinfo->bpp < 16) {
+      for (int i = 0; i < (1 << capinfo->bpp); i++) {
+         t->palette[i] = osd_get_palette(i) & 0xffffff;
+      }
+   }
+
+   record_fields = nfields;
+   record_taken = 0;
+   record_dropped = 0;
+   record_errors = 0;
+   record_written = 0;
+   record_active = 1;
+   sprintf(record_status, "Recording %d fields", nfields);
+   log_info("Recording %d fields of %d bytes to %s at sector %d", nfields, record_size, record_path, record_sector);
+   field_job_function = record_field;
+   return 1;
+}
+
+void recording_stop() {
+   if (record_active) {
+      field_job_function = NULL;
+      while (record_written != record_taken);
+      __data_memory_barrier();
+      record_report();
+   }
+}
+
+void recording_poll() {
+   if (record_active && field_job_function == NULL && record_written == record_taken) {
+      __data_memory_barrier();
+      record_report();
+   }
+}
+
+int recording_show(int line) {
+   osd_set(line++, 0, record_path);
+   if (record_active) {
+      sprintf(record_status, "%d of %d fields, %d dropped", record_taken, record_fields, record_dropped);
+   }
+   osd_set(line++, 0, record_status);
+   return line;
+}
@@ -0,0 +1,77 @@
+// recording.h
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdint.h>
+#include "defs.h"
+
+// Field recording writes a run of consecutive fields, straight from the frame buffer,
+// to one preallocated contiguous file. Each field is a record_header_t followed by
+// the raw page (pitch * height bytes at 4, 8 or 16bpp as captured), padded to a whole
+// number of sectors so every record is record_size bytes.
+//
+// A recording stopped early leaves the rest of the file as it was, so readers should
+// stop at the first record whose magic, session or field number is not as expected.
+//
+// For an interlaced source the page holds both fields woven together and the next field
+// is drawn into it while the record is copied, so only the lines of the field given by
+// BIT_FIELD_TYPE in flags are complete. The other lines can be a mix of the previous and
+// next fields.
+
+#define RECORD_MAGIC        0x31444652   // "RFD1"
+#define RECORD_HEADER_SIZE  2048         // data starts this far into each record
+#define RECORD_SECTOR_SIZE  512
+
+typedef struct {
+   uint32_t magic;
+   uint32_t header_size;
+   uint32_t record_size;       // header, data and padding
+   uint32_t data_size;         // pitch * height
+   uint32_t session;           // the same in every record of one recording
+   uint32_t fields;            // fields requested
+   uint32_t field;             // index of this record in the file
+   uint32_t dropped;           // fields missed so far because no buffer or core was free
+   uint32_t flags;             // rgb_to_fb flags for this field (BIT_FIELD_TYPE etc)
+   uint32_t timestamp;         // cycle counter when the field was handed off
+   uint32_t hsync_period;      // total_hsync_period (cycles over nlines - 1 lines)
+   uint32_t vsync_period;      // cycles
+   // capture_info_t
+   int32_t  pitch;
+   int32_t  width;
+   int32_t  height;
+   int32_t  sizex2;
+   int32_t  bpp;
+   int32_t  chars_per_line;
+   int32_t  nlines;
+   int32_t  h_offset;
+   int32_t  v_offset;
+   int32_t  palette_control;
+   int32_t  sample_width;
+   int32_t  h_adjust;
+   int32_t  v_adjust;
+   int32_t  sync_type;
+   int32_t  detected_sync_type;
+   int32_t  vsync_type;
+   int32_t  video_type;
+   int32_t  ntscphase;
+   int32_t  border;
+   int32_t  delay;
+   int32_t  mode7;
+   int32_t  px_sampling;
+   uint32_t palette[256];      // 0x00BBGGRR, entries past 1 << bpp are zero
+} record_header_t;
+
+// Starts recording nfields fields, returns 0 if it can't (no worker core, memory or space)
+int recording_start(capture_info_t *capinfo, int nfields);
+
+// Stops taking fields and waits for those already taken to reach the card
+void recording_stop();
+
+// Reports a recording that has finished, called once per field from the main loop
+void recording_poll();
+
+// Shows the state of the current or last recording on the OSD, returns the next free line
+int recording_show(int line);
+
+#endif
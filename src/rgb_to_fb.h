@@ -93,6 +93,39 @@ extern int vsync_retry_count;
 extern int dummyscreen;
 extern int core_1_available;
 extern int start_core_1_code;
+extern int cores_available;
+extern int line_jobs_inline;
+extern int line_ring_overruns;
+extern int line_ring_max_depth;
+
+// Line descriptor passed through the ring from the capture core to the worker cores
+// (layout is shared with rgb_to_fb.S, see LINE_DESC_SIZE)
+typedef struct {
+   uint8_t *src;     // line just captured
+   uint8_t *dst;     // line skipped for double height, otherwise the same as src
+   int flags;        // r3 flags at the time of capture
+   int line;         // line number from the top of the capture
+} line_desc_t;
+
+// Work handed to cores 1-3, arguments are passed in r0-r3
+typedef void (*core_job_t)(int arg0, int arg1, int arg2, int arg3);
+
+// Lines can be processed by any worker core in any order
+typedef void (*line_job_t)(line_desc_t *desc);
+
+// Set to have every captured line passed to a worker core for post processing
+extern line_job_t line_job_function;
+
+// Called on the capture core after the last line of each field with the page just drawn,
+// it has until the next field starts so should hand any real work to a worker core
+typedef void (*field_job_t)(uint8_t *page, int flags);
+
+extern field_job_t field_job_function;
+
+int post_core_job(core_job_t function, int arg0, int arg1, int arg2, int arg3);
+int line_ring_put(uint8_t *src, uint8_t *dst, int flags, int line);
+int line_ring_get(line_desc_t *desc);
+void line_ring_reset();
 
 int recalculate_hdmi_clock_line_locked_update();
 
@@ -107,6 +140,8 @@ void wait_for_source_fieldsync();
 int scan_for_single_pixels_4bpp(uint32_t * start, int length);
 int scan_for_single_pixels_12bpp(uint32_t * start, int length);
 void scan_for_diffs_12bpp(uint32_t *fbp, uint32_t *lastp, int length, int diff[NUM_OFFSETS]);
+int scan_for_diffs_4bpp_neon(uint32_t *fbp, uint32_t *lastp, int length, int diff[NUM_OFFSETS]);
+int scan_for_diffs_8bpp_neon(uint32_t *fbp, uint32_t *lastp, int length, int diff[NUM_OFFSETS]);
 
 int benchmarkRAM(int address);
 
@@ -13,6 +13,8 @@
 #include "rpi-gpio.h"
 #include "rpi-interrupts.h"
 #include "rpi-mailbox-interface.h"
+#include "rpi-dma.h"
+#include "fatfs/block.h"
 #include "startup.h"
 #include "rpi-mailbox.h"
 #include "osd.h"
@@ -24,14 +26,18 @@
 #include "cpld_null.h"
 #include "geometry.h"
 #include "filesystem.h"
+#include "recording.h"
+#include "deinterlace.h"
 #include "rgb_to_fb.h"
 #include "jtag/update_cpld.h"
 #include "vid_cga_comp.h"
+#include "linetiming.h"
 #include "videocore.c"
 #include "gitversion.h"
 #include "vid_cga_comp.h"
 
 // #define INSTRUMENT_CAL
+// #define VERIFY_NEON_CAL      // check the NEON calibration diffs against the scalar reference
 #define NUM_CAL_PASSES 1
 
 typedef void (*func_ptr)();
@@ -265,7 +271,12 @@ void start_vc()
    int func;
    func = (int) &___videocore_asm[0];
    RPI_PropertyInit();
+#ifdef USE_GPU_LINE_BUFFER
+   // r1 is the bus address of the line buffer (uncached alias, as for the frame buffer)
+   RPI_PropertyAddTag(TAG_LAUNCH_VPU1,func,0,GPU_LINE_BUFFER + 0xC0000000,0,0,0,0);
+#else
    RPI_PropertyAddTag(TAG_LAUNCH_VPU1,func,0,0,0,0,0,0);
+#endif
    RPI_PropertyProcessNoCheck();
 }
 #endif
@@ -382,6 +393,21 @@ static void init_gpclk(int source, int divisor) {
 }
 
 #ifdef USE_PROPERTY_INTERFACE_FOR_FB
+// Everything the frame buffer allocation depends on
+typedef struct {
+   int width;
+   int height;
+   int bpp;
+   int top_overscan;
+   int bottom_overscan;
+   int left_overscan;
+   int right_overscan;
+   int hdisplay;
+   int vdisplay;
+} fb_layout_t;
+
+static fb_layout_t current_fb_layout;
+
 // this is the current one used
 static void init_framebuffer(capture_info_t *capinfo) {
 static int last_width = -1;
@@ -392,32 +418,6 @@ int height = 0;
 
     rpi_mailbox_property_t *mp;
 
-    if (capinfo->width != last_width || capinfo->height != last_height) {
-       //if (last_width != -1 && last_height != -1) {
-       //   clear_full_screen();
-       //}
-       // Fill in the frame buffer structure with a small dummy frame buffer first
-       /* Initialise a framebuffer... */
-       RPI_PropertyInit();
-       RPI_PropertyAddTag(TAG_ALLOCATE_BUFFER, 0x02000000);
-       RPI_PropertyAddTag(TAG_SET_PHYSICAL_SIZE, 64, 64);
-    #ifdef MULTI_BUFFER
-       RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, 64, 64);
-    #else
-       RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, 64, 64);
-    #endif
-       RPI_PropertyAddTag(TAG_SET_DEPTH, capinfo->bpp);
-
-       RPI_PropertyProcess();
-
-
-        // FIXME: A small delay (like the log) is neccessary here
-        // or the RPI_PropertyGet seems to return garbage
-        log_info("Width or Height differ from last FB: Setting dummy 64x64 framebuffer");
-
-    }
-
-
     //last_width = capinfo->width;
     //last_height = capinfo->height;
     /* work out if overscan needed */
@@ -468,6 +468,43 @@ int height = 0;
     top_overscan += config_overscan_top;
     bottom_overscan += config_overscan_bottom;
 
+    // Nothing the firmware needs to know about has changed (e.g. autoswitching between
+    // sub-profiles with the same geometry), so keep the frame buffer and display list as
+    // they are rather than tearing them down, which blanks the display for several frames
+    fb_layout_t layout = { adjusted_width, adjusted_height, capinfo->bpp, top_overscan, bottom_overscan, left_overscan, right_overscan, get_hdisplay(), get_vdisplay() };
+    if (memcmp(&layout, &current_fb_layout, sizeof(layout)) == 0) {
+        log_info("Frame buffer unchanged");
+        clear_full_screen();   // the previous mode may have left pixels in the borders
+        osd_update_palette();
+        return;
+    }
+
+    if (capinfo->width != last_width || capinfo->height != last_height) {
+       //if (last_width != -1 && last_height != -1) {
+       //   clear_full_screen();
+       //}
+       // Fill in the frame buffer structure with a small dummy frame buffer first
+       /* Initialise a framebuffer... */
+       RPI_PropertyInit();
+       RPI_PropertyAddTag(TAG_ALLOCATE_BUFFER, 0x02000000);
+       RPI_PropertyAddTag(TAG_SET_PHYSICAL_SIZE, 64, 64);
+    #ifdef MULTI_BUFFER
+       RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, 64, 64);
+    #else
+       RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, 64, 64);
+    #endif
+       RPI_PropertyAddTag(TAG_SET_DEPTH, capinfo->bpp);
+
+       RPI_PropertyProcess();
+
+
+        // FIXME: A small delay (like the log) is neccessary here
+        // or the RPI_PropertyGet seems to return garbage
+        log_info("Width or Height differ from last FB: Setting dummy 64x64 framebuffer");
+
+    }
+
+
     log_info("Overscan L=%d, R=%d, T=%d, B=%d",left_overscan, right_overscan, top_overscan, bottom_overscan);
     /* Initialise a framebuffer... */
     RPI_PropertyInit();
@@ -511,8 +548,10 @@ int height = 0;
       // On the Pi 2/3 the mailbox returns the address with bits 31..30 set, which is wrong
       capinfo->fb = (unsigned char *)(framebuffer & 0x3fffffff);
     }
+    current_fb_layout = layout;
 
     //Initialize the palette
+    osd_invalidate_palette();
     osd_update_palette();
 
 /*
@@ -672,6 +711,7 @@ static void init_framebuffer(capture_info_t *capinfo) {
    capinfo->fb = (unsigned char *)(((unsigned int) capinfo->fb) & 0x3fffffff);
 
    // Initialize the palette
+   osd_invalidate_palette();
    osd_update_palette();
 }
 
@@ -1644,6 +1684,8 @@ static void init_hardware() {
 #ifdef RPI4
    *EMMC_LEGACY = *EMMC_LEGACY | 2;  //bit enables legacy SD controller
 #endif
+   // Before anything is loaded from the card, so everything after uses DMA
+   sd_dma_init();
    RPI_SetGpioPullUpDown(SP_DATA_MASK | SW1_MASK | SW2_MASK | SW3_MASK | VERSION_MASK | SP_CLK_MASK, GPIO_PULLUP);
    RPI_SetGpioPullUpDown(STROBE_MASK | MUX_MASK, GPIO_PULLDOWN);
 
@@ -2029,6 +2071,17 @@ static void start_core(int core, func_ptr func) {
    asm  ( "sev" );
 }
 
+#ifdef USE_MULTICORE
+static void start_worker_core(int core) {
+   int i;
+   log_info("Starting core %d at: %08X", core, _init_core);
+   start_core(core, _init_core);
+   // Each core sets up the page tables in enable_MMU_and_IDCaches so wait for it before starting the next
+   for (i = 0; i < 10000000 && !(*(volatile int *)&cores_available & (1 << core)); i++);
+   for (i = 0; i < 1000000; i++);
+}
+#endif
+
 // =============================================================
 // Public methods
 // =============================================================
@@ -2046,6 +2099,65 @@ int diff_N_frames(capture_info_t *capinfo, int n, int elk) {
    return result;
 }
 
+// Scalar reference for the 4bpp and 8bpp frame comparisons, counting the
+// pixels that differ at each sample offset. Also used on the Pi Zero/1 and
+// for any bytes at the end of a line not covered by the NEON code.
+static void scan_for_diffs_4bpp_ref(uint32_t *fbp, uint32_t *lastp, int start, int length, int diff[NUM_OFFSETS]) {
+   for (int x = start; x < length; x += 4) {
+      uint32_t d = (*fbp++ & 0x77777777) ^ (*lastp++ & 0x77777777);
+      int index = (x << 1) % NUM_OFFSETS;  //2 pixels per byte
+      while (d) {
+         if (d & 0x00000007) {
+            diff[index]++;
+         }
+         d >>= 4;
+         index = (index + 1) % NUM_OFFSETS;
+      }
+   }
+}
+
+static void scan_for_diffs_8bpp_ref(uint32_t *fbp, uint32_t *lastp, int start, int length, int diff[NUM_OFFSETS]) {
+   for (int x = start; x < length; x += 4) {
+      uint32_t d = (*fbp++ & 0x77777777) ^ (*lastp++ & 0x77777777);
+      int index = x % NUM_OFFSETS;         //1 pixel per byte
+      while (d) {
+         if (d & 0x0000007F) {
+            diff[index]++;
+         }
+         d >>= 8;
+         index = (index + 1) % NUM_OFFSETS;
+      }
+   }
+}
+
+static void scan_for_diffs(int bpp, uint32_t *fbp, uint32_t *lastp, int length, int diff[NUM_OFFSETS]) {
+   int done = 0;
+   if (_get_hardware_id() >= _RPI2) {
+      done = (bpp == 4) ? scan_for_diffs_4bpp_neon(fbp, lastp, length, diff) : scan_for_diffs_8bpp_neon(fbp, lastp, length, diff);
+   }
+   if (bpp == 4) {
+      scan_for_diffs_4bpp_ref(fbp + (done >> 2), lastp + (done >> 2), done, length, diff);
+   } else {
+      scan_for_diffs_8bpp_ref(fbp + (done >> 2), lastp + (done >> 2), done, length, diff);
+   }
+}
+
+#ifdef VERIFY_NEON_CAL
+static void verify_diffs(int bpp, uint32_t *fbp, uint32_t *lastp, int length, int diff[NUM_OFFSETS]) {
+   int ref[NUM_OFFSETS] = {0};
+   if (bpp == 4) {
+      scan_for_diffs_4bpp_ref(fbp, lastp, 0, length, ref);
+   } else {
+      scan_for_diffs_8bpp_ref(fbp, lastp, 0, length, ref);
+   }
+   for (int j = 0; j < NUM_OFFSETS; j++) {
+      if (ref[j] != diff[j]) {
+         log_warn("NEON %dbpp diff mismatch at offset %d: %d != %d", bpp, j, diff[j], ref[j]);
+      }
+   }
+}
+#endif
+
 int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
 
    unsigned int ret;
@@ -2073,26 +2185,16 @@ int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
    unsigned int flags = extra_flags() | BIT_CALIBRATE | (2 << OFFSET_NBUFFERS);
 
    uint32_t bpp      = capinfo->bpp;
-   uint32_t pix_mask;
-   uint32_t osd_mask;
 
    uint32_t mask_BIT_OSD = -1;
 
    switch (bpp) {
        case 4:
-            pix_mask = 0x00000007;
-            osd_mask = 0x77777777;
-            capinfo->ncapture = (capinfo->video_type != VIDEO_PROGRESSIVE) ? 2 : 1;
-            break;
        case 8:
-            pix_mask = 0x0000007F;
-            osd_mask = 0x77777777;
             capinfo->ncapture = (capinfo->video_type != VIDEO_PROGRESSIVE) ? 2 : 1;
             break;
        case 16:
        default:
-            pix_mask = 0x00000fff;
-            osd_mask = 0xffffffff;
             //if (capinfo->video_type == VIDEO_INTERLACED && capinfo->detected_sync_type & SYNC_BIT_INTERLACED) {
             //    mask_BIT_OSD = ~BIT_OSD;
             //}
@@ -2109,6 +2211,15 @@ int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
    ret = rgb_to_fb(capinfo, flags & mask_BIT_OSD);
 #ifdef INSTRUMENT_CAL
    t_capture += _get_cycle_counter() - t;
+#endif
+    // Progressive captures rotate through the frame buffers so the previous
+    // frame is still intact after the next capture and can be compared in place.
+    // Interlaced captures always go to buffer 0 so still need a copy, as does
+    // everything without multiple buffers.
+#ifdef MULTI_BUFFER
+    int in_place = !(capinfo->video_type != VIDEO_PROGRESSIVE && (capinfo->detected_sync_type & SYNC_BIT_INTERLACED));
+#else
+    int in_place = 0;
 #endif
     int ytotal = capinfo->nlines << (capinfo->sizex2 & SIZEX2_DOUBLE_HEIGHT);
     int ystep = 1;
@@ -2120,8 +2231,12 @@ int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
 #ifdef INSTRUMENT_CAL
       t = _get_cycle_counter();
 #endif
-      // Save the last frame
-      memcpy((void *)last, (void *)(capinfo->fb + ((ret >> OFFSET_LAST_BUFFER) & 3) * capinfo->height * capinfo->pitch), capinfo->height * capinfo->pitch);
+      unsigned char *lastfb = capinfo->fb + ((ret >> OFFSET_LAST_BUFFER) & 3) * capinfo->height * capinfo->pitch;
+      if (!in_place) {
+          // Save the last frame
+          memcpy((void *)last, (void *)lastfb, capinfo->height * capinfo->pitch);
+          lastfb = last;
+      }
 #ifdef INSTRUMENT_CAL
       t_memcpy += _get_cycle_counter() - t;
       t = _get_cycle_counter();
@@ -2144,7 +2259,7 @@ int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
     poll_soft_reset();
      // Compare the frames: start 4 lines down from the first line and end 4 lines before the end to avoid any glitchy lines when osd on.
     uint32_t *fbp = (uint32_t *)(capinfo->fb + ((ret >> OFFSET_LAST_BUFFER) & 3) * capinfo->height * capinfo->pitch + (capinfo->v_adjust + 4) * capinfo->pitch);
-    uint32_t *lastp = (uint32_t *)last + (capinfo->v_adjust + 4) * (capinfo->pitch >> 2);
+    uint32_t *lastp = (uint32_t *)(lastfb + (capinfo->v_adjust + 4) * capinfo->pitch);
 
     for (int y = 0; y < (ytotal - 4); y += ystep) {
         for (int j = 0; j < NUM_OFFSETS; j++) {
@@ -2156,33 +2271,15 @@ int *diff_N_frames_by_sample(capture_info_t *capinfo, int n, int elk) {
                 if (capinfo->mode7) {
                     single_pixel_count += scan_for_single_pixels_4bpp(fbp, capinfo->pitch);
                 }
-                for (int x = 0; x < capinfo->pitch; x += 4) {
-                    uint32_t d = (*fbp++ & osd_mask) ^ (*lastp++ & osd_mask);
-                    //uint32_t d = osd_get_equivalence(*fbp++ & osd_mask) ^ osd_get_equivalence(*lastp++ & osd_mask);
-                    int index = (x << 1) % NUM_OFFSETS;  //2 pixels per byte
-                    while (d) {
-                        if (d & pix_mask) {
-                           linediff[index]++;
-                        }
-                        d >>= 4;
-                        index = (index + 1) % NUM_OFFSETS;
-                    }
-                }
-                break;
            }
+           // fall through
            case 8:
-                for (int x = 0; x < capinfo->pitch; x += 4) {
-                    uint32_t d = (*fbp++ & osd_mask) ^ (*lastp++ & osd_mask);
-                    //uint32_t d = osd_get_equivalence(*fbp++ & osd_mask) ^ osd_get_equivalence(*lastp++ & osd_mask);
-                    int index = x % NUM_OFFSETS;         //1 pixel per byte
-                    while (d) {
-                        if (d & pix_mask) {
-                           linediff[index]++;
-                        }
-                        d >>= 8;
-                        index = (index + 1) % NUM_OFFSETS;
-                    }
-                }
+                scan_for_diffs(bpp, fbp, lastp, capinfo->pitch, linediff);
+#ifdef VERIFY_NEON_CAL
+                verify_diffs(bpp, fbp, lastp, capinfo->pitch, linediff);
+#endif
+                fbp += (capinfo->pitch >> 2);
+                lastp += (capinfo->pitch >> 2);
                 break;
            case 16:
            default:
@@ -2648,6 +2745,107 @@ void set_filtering(int filter) {
     old_filtering = filter;
 }
 
+#define HVS_FILTER_WORD(c0, c1, c2) ((((c0) & 0x1ff) << 0) | (((c1) & 0x1ff) << 9) | (((c2) & 0x1ff) << 18))
+#define HVS_KERNEL(c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15) \
+    { HVS_FILTER_WORD(c0, c1, c2), HVS_FILTER_WORD(c3, c4, c5), HVS_FILTER_WORD(c6, c7, c8), \
+      HVS_FILTER_WORD(c9, c10, c11), HVS_FILTER_WORD(c12, c13, c14), HVS_FILTER_WORD(c15, c15, 0) }
+
+// Stand ins for the firmware's scaling_kernel choices, the firmware's own kernel is used
+// for whichever one it loaded at boot
+static const uint32_t hvs_kernel_nearest[HVS_KERNEL_HALF_WORDS] = HVS_KERNEL(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 255, 255, 255, 255);
+// Mitchell-Netravali (B = C = 1/3)
+static const uint32_t hvs_kernel_soft[HVS_KERNEL_HALF_WORDS] = HVS_KERNEL(0, -2, -6, -8, -10, -8, -3, 2, 18, 50, 82, 119, 155, 187, 213, 227);
+// Cubic B-spline
+static const uint32_t hvs_kernel_very_soft[HVS_KERNEL_HALF_WORDS] = HVS_KERNEL(0, 0, 1, 4, 8, 14, 23, 35, 51, 70, 91, 112, 132, 149, 162, 169);
+
+static int hvs_kernel_offset = -1;
+static int hvs_boot_filtering = -1;
+static uint32_t hvs_boot_kernel[HVS_KERNEL_WORDS];
+
+static uint32_t read_display_list(int index) {
+    uint32_t dli;
+    do {
+        dli = display_list[index];
+    } while (dli == 0xff000000);
+    return dli;
+}
+
+static void write_display_list(int index, uint32_t dli) {
+    do {
+        display_list[index] = dli;
+    } while (display_list[index] != dli);
+}
+
+// Finds the kernel the firmware loaded from the last four words of the scaled plane (the
+// horizontal and vertical kernel offsets for both channels, which are all the same), and
+// keeps a copy of it the first time
+static int find_hvs_kernel() {
+    if (hvs_kernel_offset < 0) {
+        int index = (uint32_t) *SCALER_DISPLIST1;
+        uint32_t ctl0 = read_display_list(index);
+        int size = (ctl0 >> SCALER_CTL0_SIZE_SHIFT) & 0x3f;
+        if ((ctl0 & SCALER_CTL0_UNITY) || size < 8 || index + size > SCALER_DISPLAY_LIST_WORDS) {
+            return 0;
+        }
+        uint32_t kernel = read_display_list(index + size - 1);
+        for (int i = 2; i <= 4; i++) {
+            if (read_display_list(index + size - i) != kernel) {
+                return 0;
+            }
+        }
+        kernel &= SCALER_PPF_KERNEL_MASK;
+        if (kernel + HVS_KERNEL_WORDS > SCALER_DISPLAY_LIST_WORDS) {
+            return 0;
+        }
+        hvs_kernel_offset = kernel;
+        hvs_boot_filtering = old_filtering;
+        for (int i = 0; i < HVS_KERNEL_WORDS; i++) {
+            hvs_boot_kernel[i] = read_display_list(hvs_kernel_offset + i);
+        }
+        log_info("Scaler kernel %d at display list word %04X", hvs_boot_filtering, hvs_kernel_offset);
+    }
+    return 1;
+}
+
+// Rewrites the scaler kernel in place so a filtering change takes effect at the next vsync,
+// returns 0 if that isn't possible and a reboot is still needed
+static int set_hvs_kernel(int filter) {
+#ifdef RPI4
+    return 0;
+#else
+    if (!find_hvs_kernel()) {
+        return 0;
+    }
+    uint32_t kernel[HVS_KERNEL_WORDS];
+    const uint32_t *half;
+    if (filter == hvs_boot_filtering) {
+        memcpy(kernel, hvs_boot_kernel, sizeof(kernel));
+    } else {
+        switch (filter) {
+        case FILTERING_NEAREST_NEIGHBOUR:
+            half = hvs_kernel_nearest;
+            break;
+        case FILTERING_SOFT:
+            half = hvs_kernel_soft;
+            break;
+        case FILTERING_VERY_SOFT:
+            half = hvs_kernel_very_soft;
+            break;
+        default:
+            return 0;
+        }
+        for (int i = 0; i < HVS_KERNEL_WORDS; i++) {
+            kernel[i] = (i < HVS_KERNEL_HALF_WORDS) ? half[i] : half[HVS_KERNEL_WORDS - i - 1];
+        }
+    }
+    wait_for_pi_fieldsync();
+    for (int i = 0; i < HVS_KERNEL_WORDS; i++) {
+        write_display_list(hvs_kernel_offset + i, kernel[i]);
+    }
+    return 1;
+#endif
+}
+
 int  get_adjusted_ntscphase() {
    int phase = parameters[F_NTSC_PHASE];
    if (parameters[F_NTSC_QUALITY] == FRINGE_SOFT) {
@@ -2663,6 +2861,14 @@ int get_core_1_available() {
    return core_1_available;
 }
 
+int get_worker_cores() {
+#ifdef USE_MULTICORE
+   return ((cores_available >> 1) & 1) + ((cores_available >> 2) & 1) + ((cores_available >> 3) & 1);
+#else
+   return 0;
+#endif
+}
+
 int get_lines_per_vsync() {
     int lines = geometry_get_value(LINES_FRAME);
     if (lines_per_vsync > (lines - 20) && lines_per_vsync <= (lines + 1)) {
@@ -2819,13 +3025,19 @@ void set_scaling(int value, int reboot) {
    parameters[F_SCALING] = value;
    set_gscaling(gscaling);
 
-   if (reboot != 0 && filtering != old_filtering) {
+   int filtering_changed = reboot != 0 && filtering != old_filtering;
+   if (filtering_changed && set_hvs_kernel(filtering)) {
+       log_info("Changed scaler kernel to %d", filtering);
+       old_filtering = filtering;
+       reboot_required &= ~0x02;
+   } else if (filtering_changed) {
        reboot_required |= 0x02;
        log_info("Requesting reboot %d", filtering);
    } else {
        reboot_required &= ~0x02;
    }
-   if (reboot == 1 || (reboot == 2 && reboot_required)) {
+   // config.txt still has to match for the next boot
+   if (reboot == 1 || (reboot == 2 && (reboot_required || filtering_changed))) {
       file_save_config(resolution_name, parameters[F_REFRESH], parameters[F_SCALING], filtering, parameters[F_FRONTEND], parameters[F_HDMI_MODE], auto_workaround_path);
    }
 }
@@ -3156,6 +3368,8 @@ void rgb_to_hdmi_main() {
    start_vc();
 #endif
 
+   RPI_DMA_Init();
+
    // Determine initial sync polarity (and correct whether inversion required or not)
    capinfo->detected_sync_type = cpld->analyse(capinfo->sync_type, 1);
    log_info("Detected polarity state at startup = %x, %s (%s)", capinfo->detected_sync_type, sync_names[capinfo->detected_sync_type & SYNC_BIT_MASK], mixed_names[(capinfo->detected_sync_type & SYNC_BIT_MIXED_SYNC) ? 1 : 0]);
@@ -3207,11 +3421,15 @@ void rgb_to_hdmi_main() {
        } else {
            log_info("Second core NOT available");
        }
+       log_info("Worker cores available: %d", get_worker_cores());
    }
    while (1) {
       log_info("-----------------------LOOP------------------------");
       if (parameters[F_PROFILE] != last_profile || last_saved_config_number != parameters[F_SAVED_CONFIG]) {
           last_subprofile  = -1;
+#ifdef INSTRUMENT_LINES
+          line_timing_reset();
+#endif
       }
       setup_profile(parameters[F_PROFILE] != last_profile || last_subprofile != parameters[F_SUB_PROFILE] || last_saved_config_number != parameters[F_SAVED_CONFIG]);
       if ((parameters[F_AUTO_SWITCH] != AUTOSWITCH_OFF) && sub_profiles_available(parameters[F_PROFILE]) && ((result & (RET_SYNC_TIMING_CHANGED | RET_SYNC_STATE_CHANGED)) || parameters[F_PROFILE] != last_profile || last_subprofile != parameters[F_SUB_PROFILE] || restart_profile)) {
@@ -3280,6 +3498,9 @@ void rgb_to_hdmi_main() {
            log_info("ARM: GPIO read = %dns, MBOX read = %dns, Triple MBOX read = %dns (%dns/word)", (int)((double) benchmarkRAM(3) * 1000 / cpuspeed / 100000 + 0.5), (int)((double) benchmarkRAM(4) * 1000 / cpuspeed / 100000 + 0.5), triple, triple / 3);
            log_info("GPU: GPIO read = %dns, MBOX write = %dns", (int)((double) benchmarkRAM(1) * 1000 / cpuspeed / 100000 + 0.5), (int)((double) benchmarkRAM(2) * 1000 / cpuspeed / 100000 + 0.5));
            log_info("RAM: Cached read = %dns, Uncached screen read = %dns", (int)((double) benchmarkRAM(0x2000000) * 1000 / cpuspeed / 100000 + 0.5), (int)((double) benchmarkRAM((int)capinfo->fb) * 1000 / cpuspeed / 100000 + 0.5));
+#ifdef USE_GPU_LINE_BUFFER
+           log_info("RAM: GPU line buffer read = %dns", (int)((double) benchmarkRAM(GPU_LINE_BUFFER) * 1000 / cpuspeed / 100000 + 0.5));
+#endif
 
 
 //***********test CGA artifact decode*********************
@@ -3392,12 +3613,22 @@ void rgb_to_hdmi_main() {
 
          //paletteFlags |= BIT_MULTI_PALETTE;   // test multi palette
          if (capinfo->mode7) {
+            deinterlace_stop();
             if (capinfo->video_type == VIDEO_TELETEXT) {
                 flags |= parameters[F_MODE7_DEINTERLACE] << OFFSET_INTERLACE;
             } else {
                 flags |= (parameters[F_MODE7_DEINTERLACE] & 1) << OFFSET_INTERLACE;
             }
+         } else if (parameters[F_NORMAL_DEINTERLACE] == DEINTERLACE_MOTION) {
+            // captured woven, the worker cores fill in the moving parts of the other field
+            if (capinfo->video_type == VIDEO_INTERLACED && interlaced && deinterlace_start(capinfo)) {
+               flags |= DEINTERLACE_NONE << OFFSET_INTERLACE;
+            } else {
+               deinterlace_stop();
+               flags |= DEINTERLACE_BOB << OFFSET_INTERLACE;
+            }
          } else {
+            deinterlace_stop();
             flags |= parameters[F_NORMAL_DEINTERLACE] << OFFSET_INTERLACE;
          }
 #ifdef MULTI_BUFFER
@@ -3524,6 +3755,10 @@ void rgb_to_hdmi_main() {
             ncapture = osd_key(OSD_SW3);
          }
 
+         // report any screenshot, log save or recording finished by a worker core
+         filesystem_poll();
+         recording_poll();
+
          cpld->update_capture_info(capinfo);
          geometry_get_fb_params(capinfo);
          capinfo->palette_control = parameters[F_PALETTE_CONTROL];
@@ -3719,19 +3954,25 @@ void kernel_main(unsigned int r0, unsigned int r1, unsigned int atags)
  #else
         if (_get_hardware_id() >= _RPI2 ) {
  #endif
-            log_info("Starting core 1 at: %08X", _init_core);
-            start_core(1, _init_core);
+            start_worker_core(1);
+            start_worker_core(2);
+            start_worker_core(3);
         } else {
             start_core(1, _spin_core);
+            for (i = 0; i < 10000000; i++);
+            start_core(2, _spin_core);
+            for (i = 0; i < 10000000; i++);
+            start_core(3, _spin_core);
+            for (i = 0; i < 10000000; i++);
         }
 #else
         start_core(1, _spin_core);
-#endif
         for (i = 0; i < 10000000; i++);
         start_core(2, _spin_core);
         for (i = 0; i < 10000000; i++);
         start_core(3, _spin_core);
         for (i = 0; i < 10000000; i++);
+#endif
     }
 
     rgb_to_hdmi_main();
@@ -22,6 +22,7 @@ int  get_adjusted_ntscphase();
 int  get_lines_per_vsync();
 int  get_50hz_state();
 int  get_core_1_available();
+int  get_worker_cores();
 
 void set_parameter(int parameter, int value);
 int get_parameter(int parameter);
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include "cache.h"
+#include "logging.h"
+#include "startup.h"
+#include "rpi-mailbox-interface.h"
+#include "rpi-dma.h"
+
+// One control block and the fill pattern, in uncached memory so the DMA engine sees
+// them without any cache maintenance (after the GPU line buffer, see defs.h)
+#define DMA_CONTROL_BLOCK  (UNCACHED_MEM_BASE + 0x30000)
+
+// The GPU's uncached alias, as used for the frame buffer
+#define BUS_ADDRESS(x)     ((((uint32_t) (x)) & 0x3fffffff) | 0xC0000000)
+
+volatile uint32_t *dma_status_reg = 0;
+
+static rpi_dma_channel_t *dma_channel = 0;
+static rpi_dma_cb_t *dma_cb = (rpi_dma_cb_t *) DMA_CONTROL_BLOCK;
+static uint32_t *dma_fill_pattern = (uint32_t *) (DMA_CONTROL_BLOCK + sizeof(rpi_dma_cb_t));
+
+static uint32_t dma_free_mask = 0;
+static int dma_mask_read = 0;
+
+rpi_dma_channel_t *RPI_DMA_Claim(void) {
+   if (!dma_mask_read) {
+      rpi_mailbox_property_t *buf;
+      RPI_PropertyInit();
+      RPI_PropertyAddTag(TAG_GET_DMA_CHANNELS);
+      RPI_PropertyProcess();
+      buf = RPI_PropertyGet(TAG_GET_DMA_CHANNELS);
+      if (!buf) {
+         log_warn("DMA: unable to read channel mask");
+         return 0;
+      }
+      dma_free_mask = buf->data.buffer_32[0];
+      dma_mask_read = 1;
+   }
+   int channel = RPI_DMA_FULL_CHANNELS - 1;
+   // take the highest free full channel, the firmware allocates from the bottom
+   while (channel >= 0 && !(dma_free_mask & (1 << channel))) {
+      channel--;
+   }
+   if (channel < 0) {
+      log_warn("DMA: no full channel free");
+      return 0;
+   }
+   dma_free_mask &= ~(1 << channel);
+   rpi_reg_rw_t *enable = (rpi_reg_rw_t *) (RPI_DMA_BASE + RPI_DMA_ENABLE_OFFSET);
+   *enable |= 1 << channel;
+   rpi_dma_channel_t *claimed = (rpi_dma_channel_t *) (RPI_DMA_BASE + channel * RPI_DMA_CHANNEL_SIZE);
+   claimed->cs = DMA_CS_RESET;
+   while (claimed->cs & DMA_CS_RESET);
+   log_info("DMA: claimed channel %d", channel);
+   return claimed;
+}
+
+int RPI_DMA_Init(void) {
+   dma_channel = RPI_DMA_Claim();
+   if (!dma_channel) {
+      return 0;
+   }
+   dma_status_reg = &dma_channel->cs;
+   return 1;
+}
+
+int RPI_DMA_Busy(void) {
+   return dma_channel && (dma_channel->cs & DMA_CS_ACTIVE);
+}
+
+void RPI_DMA_Wait(void) {
+   if (dma_channel) {
+      while (dma_channel->cs & DMA_CS_ACTIVE);
+   }
+}
+
+int RPI_DMA_Fill(void *dst, uint32_t value, uint32_t bytes) {
+   if (!dma_channel || bytes == 0 || ((bytes | (uint32_t) dst) & 3)) {
+      return 0;
+   }
+   uint32_t ti = DMA_TI_DEST_INC | DMA_TI_WAIT_RESP | DMA_TI_BURST_LENGTH(4);
+   // 128 bit writes when everything is 16 byte aligned, the pattern is read without incrementing
+   if (((bytes | (uint32_t) dst) & 15) == 0) {
+      ti |= DMA_TI_SRC_WIDTH | DMA_TI_DEST_WIDTH;
+   }
+   RPI_DMA_Wait();
+   for (int i = 0; i < 4; i++) {
+      dma_fill_pattern[i] = value;
+   }
+   dma_cb->ti = ti;
+   dma_cb->source_ad = BUS_ADDRESS(dma_fill_pattern);
+   dma_cb->dest_ad = BUS_ADDRESS(dst);
+   dma_cb->txfr_len = bytes;
+   dma_cb->stride = 0;
+   dma_cb->nextconbk = 0;
+   __data_memory_barrier();
+   dma_channel->cs = DMA_CS_END | DMA_CS_INT;
+   dma_channel->conblk_ad = BUS_ADDRESS(dma_cb);
+   dma_channel->cs = DMA_CS_ACTIVE | DMA_CS_PRIORITY(8) | DMA_CS_PANIC_PRIORITY(8) | DMA_CS_WAIT_FOR_OUTSTANDING_WRITES;
+   return 1;
+}
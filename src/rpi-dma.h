@@ -0,0 +1,85 @@
+// rpi-dma.h
+
+#ifndef RPI_DMA_H
+#define RPI_DMA_H
+
+#include <stdint.h>
+
+#include "rpi-base.h"
+
+#define RPI_DMA_BASE            ( _get_peripheral_base() + 0x7000 )
+#define RPI_DMA_CHANNEL_SIZE    0x100
+#define RPI_DMA_ENABLE_OFFSET   0xFF0
+
+// Channels 0 to 6 are full channels, the lite channels above have a shorter maximum transfer
+#define RPI_DMA_FULL_CHANNELS   7
+
+// CS register
+#define DMA_CS_ACTIVE           (1 << 0)
+#define DMA_CS_END              (1 << 1)
+#define DMA_CS_INT              (1 << 2)
+#define DMA_CS_ERROR            (1 << 8)
+#define DMA_CS_PRIORITY(x)      ((x) << 16)
+#define DMA_CS_PANIC_PRIORITY(x) ((x) << 20)
+#define DMA_CS_WAIT_FOR_OUTSTANDING_WRITES (1 << 28)
+#define DMA_CS_ABORT            (1 << 30)
+#define DMA_CS_RESET            (1U << 31)
+
+// Transfer information
+#define DMA_TI_TDMODE           (1 << 1)
+#define DMA_TI_WAIT_RESP        (1 << 3)
+#define DMA_TI_DEST_INC         (1 << 4)
+#define DMA_TI_DEST_WIDTH       (1 << 5)   // 128 bit
+#define DMA_TI_DEST_DREQ        (1 << 6)
+#define DMA_TI_SRC_INC          (1 << 8)
+#define DMA_TI_SRC_WIDTH        (1 << 9)   // 128 bit
+#define DMA_TI_SRC_DREQ         (1 << 10)
+#define DMA_TI_BURST_LENGTH(x)  ((x) << 12)
+#define DMA_TI_PERMAP(x)        ((x) << 16)
+#define DMA_TI_NO_WIDE_BURSTS   (1 << 26)
+
+typedef struct {
+   rpi_reg_rw_t cs;
+   rpi_reg_rw_t conblk_ad;
+   rpi_reg_ro_t ti;
+   rpi_reg_ro_t source_ad;
+   rpi_reg_ro_t dest_ad;
+   rpi_reg_ro_t txfr_len;
+   rpi_reg_ro_t stride;
+   rpi_reg_ro_t nextconbk;
+   rpi_reg_rw_t debug;
+} rpi_dma_channel_t;
+
+// Control block, must be 32 byte aligned
+typedef struct {
+   uint32_t ti;
+   uint32_t source_ad;
+   uint32_t dest_ad;
+   uint32_t txfr_len;
+   uint32_t stride;
+   uint32_t nextconbk;
+   uint32_t reserved[2];
+} rpi_dma_cb_t;
+
+// CS register of the channel used for frame buffer fills and copies, 0 if there is none.
+// Polled by the capture loop (see WAIT_FOR_DMA in macros.S) so it doesn't draw into a
+// buffer that is still being cleared.
+extern volatile uint32_t *dma_status_reg;
+
+// Claims a free full channel for other drivers to program themselves (reset and enabled),
+// returns 0 if the firmware has none to spare. Uses the mailbox, so core 0 only.
+extern rpi_dma_channel_t *RPI_DMA_Claim(void);
+
+// Claims the channel for frame buffer fills and copies, returns 0 if there is none
+extern int RPI_DMA_Init(void);
+
+// Fills bytes with a 32 bit value. Returns as soon as the transfer has started, or 0
+// if it couldn't be started (no channel, or not word aligned) and the caller should
+// do it itself.
+extern int RPI_DMA_Fill(void *dst, uint32_t value, uint32_t bytes);
+
+extern int RPI_DMA_Busy(void);
+
+extern void RPI_DMA_Wait(void);
+
+#endif
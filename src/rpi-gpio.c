@@ -106,6 +106,15 @@ void RPI_SetGpioValue(rpi_gpio_pin_t gpio, rpi_gpio_value_t value)
       RPI_SetGpioHi(gpio);
 }
 
+// Sets and clears any pins in the first bank with one write each, so several outputs
+// (e.g. clock enable and data) change together rather than one call per pin
+void RPI_SetGpioMask(uint32_t set_mask, uint32_t clear_mask)
+{
+   RPI_GpioBase = (rpi_gpio_t*) RPI_GPIO_BASE;
+   RPI_GpioBase->GPCLR0 = clear_mask;
+   RPI_GpioBase->GPSET0 = set_mask;
+}
+
 void RPI_SetGpioPullUpDown(uint32_t gpio_pins, uint32_t pull_type) {
    RPI_GpioBase = (rpi_gpio_t*) RPI_GPIO_BASE;
    //log_info("Pull Type: %08X, %02X", gpio_pins, pull_type);
@@ -211,5 +211,6 @@ extern void RPI_SetGpioHi(rpi_gpio_pin_t gpio);
 extern void RPI_SetGpioLo(rpi_gpio_pin_t gpio);
 extern void RPI_SetGpioValue(rpi_gpio_pin_t gpio, rpi_gpio_value_t value);
 extern void RPI_ToggleGpio(rpi_gpio_pin_t gpio);
+extern void RPI_SetGpioMask(uint32_t set_mask, uint32_t clear_mask);
 extern void RPI_SetGpioPullUpDown(uint32_t gpio_pins, uint32_t pullup_type);
 #endif
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+cmake -G "CodeBlocks - Unix Makefiles" "$*" -DCMAKE_TOOLCHAIN_FILE=../toolchain-arm-linux-gnueabihf.cmake ../
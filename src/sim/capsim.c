@@ -0,0 +1,792 @@
+// capsim.c
+//
+// Host-side capture simulator
+//
+// Runs rgb_to_fb and the capture_line_* kernels unmodified as an ARM Linux
+// user space program (under qemu-arm, or natively on a Pi running Linux) and
+// feeds them a recorded or synthetic GPIO stream, so changes to the kernels
+// can be checked for bit exact output and timing headroom without hardware.
+//
+// How it works:
+//
+// - _get_peripheral_base / _get_GPLEV0_r4 return addresses inside a block of
+//   inaccessible memory, so every GPLEV0 read (and any other peripheral
+//   access) raises SIGSEGV. The handler decodes the ldr/str/ldm/stm, returns
+//   the stream sample for the current virtual time and steps over it.
+//
+// - Cycle counter reads (mrc p15 c9,c13,0 and the ARM11 c15,c12,1 form) are
+//   patched at startup into undefined instructions, which the SIGILL handler
+//   services from the same virtual clock.
+//
+// - Virtual time advances at every trapped instruction by an estimate of the
+//   instructions executed since the previous trap (the straight line distance
+//   between the two, or a fixed cost for loops and branches) plus the cost of
+//   the peripheral access. This is only an approximation of a real Pi but it
+//   is deterministic, so timing numbers are comparable between two versions
+//   of a kernel run against the same stream.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "defs.h"
+#include "rgb_to_fb.h"
+#include "capsim.h"
+
+// Defined in capsim_start.S
+extern uint32_t _hardware_id;
+extern uint32_t _peripheral_base;
+extern uint32_t _gplev0_base;
+extern uint32_t _gpu_data_0;
+extern uint32_t _gpu_command_base;
+
+// Provided by the linker
+extern char __executable_start[];
+extern char etext[];
+
+#define RUN_FILE_MAGIC "RGBGPIO1"
+
+#define PS_PER_NS 1000ULL
+
+// Instruction estimates used by the virtual clock
+#define POLL_LOOP_INSNS   4      // ldr / eor / tst / bne
+#define BRANCH_INSNS      8      // trap following a backwards or long branch
+#define MAX_STRAIGHT_LINE 256    // longest forward distance treated as straight line code
+
+// Pins that should read high when nothing is driving them
+#define IDLE_MASK ((1 << SW1_PIN) | (1 << SW2_PIN) | (1 << SW3_PIN) | VERSION_MASK)
+
+typedef struct {
+   uint32_t level;      // GPLEV0 value
+   uint32_t duration;   // time the value is held for (ps)
+} gpio_run_t;
+
+typedef struct {
+   uint32_t reads;          // GPLEV0 reads while this line was being sent
+   uint32_t counter_reads;  // cycle counter reads
+   uint64_t insns;          // estimated instructions executed
+   uint32_t skipped;        // psync levels not seen by any read between two that were
+   uint64_t max_latency;    // worst time from a psync edge to the first read that saw it (ps)
+   uint64_t max_gap;        // worst time between two consecutive GPLEV0 reads (ps)
+} line_stats_t;
+
+typedef struct {
+   const char *name;
+   int (*table)();
+} kernel_t;
+
+static const kernel_t kernels[] = {
+   { "normal_1bpp",          capture_line_normal_1bpp_table },
+   { "normal_3bpp",          capture_line_normal_3bpp_table },
+   { "normal_6bpp",          capture_line_normal_6bpp_table },
+   { "normal_odd_even_6bpp", capture_line_normal_odd_even_6bpp_table },
+   { "normal_9bpplo",        capture_line_normal_9bpplo_table },
+   { "normal_9bpphi",        capture_line_normal_9bpphi_table },
+   { "normal_12bpp",         capture_line_normal_12bpp_table },
+   { "odd_3bpp",             capture_line_odd_3bpp_table },
+   { "even_3bpp",            capture_line_even_3bpp_table },
+   { "double_3bpp",          capture_line_double_3bpp_table },
+   { "half_odd_3bpp",        capture_line_half_odd_3bpp_table },
+   { "half_even_3bpp",       capture_line_half_even_3bpp_table },
+   { "simple_6bpp",          capture_line_simple_6bpp_table },
+   { "simple_9bpplo",        capture_line_simple_9bpplo_table },
+   { "simple_9bpplo_blank",  capture_line_simple_9bpplo_blank_table },
+   { "simple_9bpphi",        capture_line_simple_9bpphi_table },
+   { "simple_12bpp",         capture_line_simple_12bpp_table },
+   { NULL, NULL }
+};
+
+// bits per pixel delivered on GPIOs 2..13 for each SAMPLE_WIDTH_ setting
+static const int sample_bits[] = { 1, 3, 6, 9, 9, 12 };
+
+int sim_verbose = 0;
+
+static gpio_run_t *runs;
+static uint64_t *run_start;       // start time of each run (ps)
+static int *run_line;             // source line each run belongs to
+static int nruns;
+static int nlines_stream;
+static uint64_t stream_length;    // total stream time (ps)
+static int loop_stream = 0;
+
+static line_stats_t *stats;
+
+static uint64_t vtime = 0;        // virtual time (ps)
+static uint64_t vtime_limit;
+static uint64_t loop_base = 0;    // start time of the current pass through the stream
+static int cursor = 0;            // current run
+static int last_read_run = -1;    // most recent run that saw a GPLEV0 read
+static uint64_t last_read_time = 0;
+static uint32_t last_trap_pc = 0;
+static int version_low = 0;
+
+static uint32_t cpu_mhz = 1000;
+static uint32_t insn_ps = 1000;
+static uint32_t access_ps = 25000;
+
+static sigjmp_buf sim_abort;
+static const char *abort_reason;
+
+// =============================================================
+// Logging
+// =============================================================
+
+void sim_log(const char *fmt, ...) {
+   va_list ap;
+   if (!sim_verbose) {
+      return;
+   }
+   va_start(ap, fmt);
+   fprintf(stderr, "[%10.3f us] ", (double) vtime / 1e6);
+   vfprintf(stderr, fmt, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+}
+
+static void fatal(const char *fmt, ...) {
+   va_list ap;
+   va_start(ap, fmt);
+   fprintf(stderr, "capsim: ");
+   vfprintf(stderr, fmt, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+   exit(1);
+}
+
+// =============================================================
+// GPIO streams
+// =============================================================
+
+static void add_run(int *size, uint32_t level, uint64_t duration) {
+   // merge with the previous run if the level hasn't changed
+   if (nruns > 0 && runs[nruns - 1].level == level && (uint64_t) runs[nruns - 1].duration + duration < 0xffffffffULL) {
+      runs[nruns - 1].duration += duration;
+      return;
+   }
+   while (duration > 0) {
+      uint32_t d = duration > 0xffffffffULL ? 0xffffffff : (uint32_t) duration;
+      if (nruns == *size) {
+         *size = *size ? *size * 2 : 65536;
+         runs = realloc(runs, *size * sizeof(gpio_run_t));
+         if (!runs) {
+            fatal("out of memory");
+         }
+      }
+      runs[nruns].level = level;
+      runs[nruns].duration = d;
+      nruns++;
+      duration -= d;
+   }
+}
+
+static void load_stream(const char *name, double raw_mhz) {
+   FILE *fp = fopen(name, "rb");
+   char magic[8];
+   int size = 0;
+   if (!fp) {
+      fatal("can't open %s", name);
+   }
+   if (fread(magic, 1, 8, fp) == 8 && memcmp(magic, RUN_FILE_MAGIC, 8) == 0) {
+      uint32_t header[2];
+      gpio_run_t run;
+      if (fread(header, sizeof(uint32_t), 2, fp) != 2) {
+         fatal("%s: truncated header", name);
+      }
+      while (fread(&run, sizeof(run), 1, fp) == 1) {
+         add_run(&size, run.level, run.duration);
+      }
+   } else {
+      // raw 32 bit GPLEV0 samples at a fixed rate, e.g. a logic analyser export
+      uint64_t period = (uint64_t) (1e6 / raw_mhz);
+      uint32_t sample;
+      rewind(fp);
+      while (fread(&sample, sizeof(sample), 1, fp) == 1) {
+         add_run(&size, sample, period);
+      }
+   }
+   fclose(fp);
+   if (nruns == 0) {
+      fatal("%s: no samples", name);
+   }
+}
+
+static void save_stream(const char *name) {
+   FILE *fp = fopen(name, "wb");
+   uint32_t header[2] = { nruns, 0 };
+   if (!fp) {
+      fatal("can't create %s", name);
+   }
+   fwrite(RUN_FILE_MAGIC, 1, 8, fp);
+   fwrite(header, sizeof(uint32_t), 2, fp);
+   fwrite(runs, sizeof(gpio_run_t), nruns, fp);
+   fclose(fp);
+}
+
+// Synthetic source: composite sync, progressive, colour bars
+//
+// Each field starts with vsync_lines of broad pulses (sync low for all but the
+// last hsync_ns of the line), then normal lines with an hsync_ns pulse. After
+// hsync psync toggles once per group of pixels (as the CPLD does) and the pixel
+// bits for that group are presented on GPIOs 2..13.
+static void generate_stream(int line_ns, int hsync_ns, int lines, int vsync_lines, int clock_hz, int sample_width) {
+   int size = 0;
+   int bits = sample_bits[sample_width];
+   int per_edge = bits >= 12 ? 1 : 12 / bits;
+   uint64_t line = (uint64_t) line_ns * PS_PER_NS;
+   uint64_t sync = (uint64_t) hsync_ns * PS_PER_NS;
+   uint64_t edge = (uint64_t) per_edge * 1000000000000ULL / clock_hz;
+   for (int l = 0; l < lines; l++) {
+      if (l < vsync_lines) {
+         add_run(&size, IDLE_MASK & ~VERSION_MASK, line - sync);
+         add_run(&size, (IDLE_MASK & ~VERSION_MASK) | CSYNC_MASK, sync);
+         continue;
+      }
+      add_run(&size, IDLE_MASK, sync);
+      uint64_t t = sync;
+      int psync = 0;
+      int x = 0;
+      while (t + edge <= line) {
+         uint32_t pixels = 0;
+         psync ^= 1;
+         for (int i = 0; i < per_edge; i++, x++) {
+            int bar = (x >> 5) & 7;
+            uint32_t p = 0;
+            int cbits = bits / 3;
+            if (cbits == 0) {
+               p = bar & 1;
+            } else {
+               for (int c = 0; c < 3; c++) {
+                  if (bar & (1 << c)) {
+                     p |= ((1 << cbits) - 1) << (c * cbits);
+                  }
+               }
+            }
+            pixels |= p << (i * bits);
+         }
+         add_run(&size, IDLE_MASK | CSYNC_MASK | (psync ? PSYNC_MASK : 0) | (pixels << PIXEL_BASE), edge);
+         t += edge;
+      }
+      add_run(&size, IDLE_MASK | CSYNC_MASK, line - t);
+   }
+}
+
+// Work out where each run starts and which source line it belongs to
+static void index_stream() {
+   int line = 0;
+   run_start = malloc(nruns * sizeof(uint64_t));
+   run_line = malloc(nruns * sizeof(int));
+   if (!run_start || !run_line) {
+      fatal("out of memory");
+   }
+   stream_length = 0;
+   for (int i = 0; i < nruns; i++) {
+      if (i > 0 && (runs[i - 1].level & CSYNC_MASK) && !(runs[i].level & CSYNC_MASK)) {
+         line++;
+      }
+      run_start[i] = stream_length;
+      run_line[i] = line;
+      stream_length += runs[i].duration;
+   }
+   nlines_stream = line + 1;
+   stats = calloc(nlines_stream, sizeof(line_stats_t));
+   if (!stats) {
+      fatal("out of memory");
+   }
+}
+
+// Move the cursor to the run being sent at the current virtual time
+static void stream_seek() {
+   if (vtime >= vtime_limit) {
+      abort_reason = "virtual time limit reached";
+      siglongjmp(sim_abort, 1);
+   }
+   while (vtime >= loop_base + run_start[cursor] + runs[cursor].duration) {
+      cursor++;
+      if (cursor == nruns) {
+         if (!loop_stream) {
+            abort_reason = "end of stream";
+            siglongjmp(sim_abort, 1);
+         }
+         loop_base += stream_length;
+         cursor = 0;
+         last_read_run = -1;
+      }
+   }
+}
+
+static uint32_t gplev0_read() {
+   line_stats_t *s;
+   uint32_t level;
+   stream_seek();
+   s = &stats[run_line[cursor]];
+   s->reads++;
+   if (last_read_run >= 0 && run_line[last_read_run] == run_line[cursor]) {
+      uint64_t gap = vtime - last_read_time;
+      if (gap > s->max_gap) {
+         s->max_gap = gap;
+      }
+      // only count levels missed while psync is toggling (i.e. not during sync)
+      if (cursor > last_read_run + 1 && (runs[cursor].level & CSYNC_MASK) && (runs[last_read_run].level & CSYNC_MASK)) {
+         s->skipped += cursor - last_read_run - 1;
+      }
+   }
+   if (cursor != last_read_run && cursor > 0 && ((runs[cursor].level ^ runs[cursor - 1].level) & PSYNC_MASK)) {
+      uint64_t latency = vtime - (loop_base + run_start[cursor]);
+      if (latency > s->max_latency) {
+         s->max_latency = latency;
+      }
+   }
+   last_read_run = cursor;
+   last_read_time = vtime;
+   level = runs[cursor].level;
+   if (version_low) {
+      // vsync is routed onto psync; streams carry vsync (active low) on the version pin
+      level = (level & ~PSYNC_MASK) | ((level & VERSION_MASK) ? 0 : PSYNC_MASK);
+   }
+   return level;
+}
+
+void sim_set_version_pin(int state) {
+   version_low = !state;
+}
+
+// =============================================================
+// Virtual clock
+// =============================================================
+
+static void advance(uint32_t pc, uint32_t cost) {
+   uint32_t insns;
+   if (pc == last_trap_pc) {
+      insns = POLL_LOOP_INSNS;
+   } else if (pc > last_trap_pc && pc - last_trap_pc <= MAX_STRAIGHT_LINE * 4) {
+      insns = (pc - last_trap_pc) >> 2;
+   } else {
+      insns = BRANCH_INSNS;
+   }
+   last_trap_pc = pc;
+   vtime += (uint64_t) insns * insn_ps + cost;
+   if (cursor < nruns) {
+      stats[run_line[cursor]].insns += insns;
+   }
+}
+
+static uint32_t cycle_counter() {
+   return (uint32_t) (vtime * cpu_mhz / 1000000);
+}
+
+// =============================================================
+// Fault handlers
+// =============================================================
+
+static uint32_t *context_regs(void *ctx) {
+   ucontext_t *uc = (ucontext_t *) ctx;
+   return (uint32_t *) &uc->uc_mcontext.arm_r0;  // r0..r15 are contiguous
+}
+
+static uint32_t context_cpsr(void *ctx) {
+   ucontext_t *uc = (ucontext_t *) ctx;
+   return uc->uc_mcontext.arm_cpsr;
+}
+
+static int condition_passed(int cond, uint32_t cpsr) {
+   int n = (cpsr >> 31) & 1;
+   int z = (cpsr >> 30) & 1;
+   int c = (cpsr >> 29) & 1;
+   int v = (cpsr >> 28) & 1;
+   switch (cond) {
+   case 0x0: return z;
+   case 0x1: return !z;
+   case 0x2: return c;
+   case 0x3: return !c;
+   case 0x4: return n;
+   case 0x5: return !n;
+   case 0x6: return v;
+   case 0x7: return !v;
+   case 0x8: return c && !z;
+   case 0x9: return !c || z;
+   case 0xa: return n == v;
+   case 0xb: return n != v;
+   case 0xc: return !z && n == v;
+   case 0xd: return z || n != v;
+   default:  return 1;
+   }
+}
+
+static uint32_t peripheral_read(uint32_t pc, uint32_t offset) {
+   advance(pc, access_ps);
+   if (offset == SIM_GPLEV0) {
+      return gplev0_read();
+   }
+   return 0;
+}
+
+static void peripheral_write(uint32_t pc, uint32_t offset, uint32_t value) {
+   advance(pc, access_ps);
+   if (offset == SIM_GPCLR0 && (value & VERSION_MASK)) {
+      version_low = 1;
+   } else if (offset == SIM_GPSET0 && (value & VERSION_MASK)) {
+      version_low = 0;
+   }
+}
+
+static void segv_handler(int sig, siginfo_t *si, void *ctx) {
+   uint32_t *regs = context_regs(ctx);
+   uint32_t pc = regs[15];
+   uint32_t insn = *(uint32_t *) pc;
+   uint32_t addr = (uint32_t) si->si_addr;
+   int rn = (insn >> 16) & 15;
+   int load = (insn >> 20) & 1;
+
+   if (addr - _peripheral_base >= SIM_PERIPHERAL_SIZE) {
+      signal(SIGSEGV, SIG_DFL);
+      fprintf(stderr, "capsim: segmentation fault at pc=%08x addr=%08x\n", pc, addr);
+      return;
+   }
+
+   if ((insn & 0x0c000000) == 0x04000000) {
+      // ldr / str / ldrb / strb
+      int rd = (insn >> 12) & 15;
+      int byte = (insn >> 22) & 1;
+      uint32_t offset = addr - _peripheral_base;
+      if (load) {
+         uint32_t value = peripheral_read(pc, offset & ~3);
+         regs[rd] = byte ? (value >> ((offset & 3) * 8)) & 0xff : value;
+      } else {
+         peripheral_write(pc, offset & ~3, regs[rd]);
+      }
+      if (!(insn & (1 << 24)) || (insn & (1 << 21))) {
+         uint32_t imm;
+         if (insn & (1 << 25)) {
+            fatal("unsupported register offset writeback at pc=%08x", pc);
+         }
+         imm = insn & 0xfff;
+         if (insn & (1 << 24)) {
+            regs[rn] = addr;
+         } else {
+            regs[rn] = (insn & (1 << 23)) ? regs[rn] + imm : regs[rn] - imm;
+         }
+      }
+   } else if ((insn & 0x0e000000) == 0x08000000) {
+      // ldm / stm
+      uint32_t list = insn & 0xffff;
+      int n = __builtin_popcount(list);
+      int up = (insn >> 23) & 1;
+      int pre = (insn >> 24) & 1;
+      uint32_t base = regs[rn];
+      uint32_t start = up ? base + (pre ? 4 : 0) : base - 4 * n + (pre ? 0 : 4);
+      for (int r = 0; r < 16; r++) {
+         if (list & (1 << r)) {
+            if (load) {
+               regs[r] = peripheral_read(pc, start - _peripheral_base);
+            } else {
+               peripheral_write(pc, start - _peripheral_base, regs[r]);
+            }
+            start += 4;
+         }
+      }
+      if ((insn & (1 << 21)) && !(load && (list & (1 << rn)))) {
+         regs[rn] = up ? base + 4 * n : base - 4 * n;
+      }
+   } else {
+      fatal("unsupported peripheral access %08x at pc=%08x", insn, pc);
+   }
+   regs[15] = pc + 4;
+}
+
+static void ill_handler(int sig, siginfo_t *si, void *ctx) {
+   uint32_t *regs = context_regs(ctx);
+   uint32_t pc = regs[15];
+   uint32_t insn = *(uint32_t *) pc;
+
+   if ((insn & SIM_UDF_MASK) == SIM_UDF_CYCLE_COUNTER) {
+      advance(pc, 0);
+      if (condition_passed((insn >> 8) & 15, context_cpsr(ctx))) {
+         regs[insn & 15] = cycle_counter();
+         if (cursor < nruns) {
+            stats[run_line[cursor]].counter_reads++;
+         }
+      }
+   } else if ((insn & 0x0f000f10) == 0x0e000f10) {
+      // any other cp15 access (barriers, cache maintenance) is ignored
+      advance(pc, 0);
+      if ((insn & (1 << 20)) && condition_passed(insn >> 28, context_cpsr(ctx))) {
+         int rt = (insn >> 12) & 15;
+         if (rt != 15) {
+            regs[rt] = 0;
+         }
+      }
+   } else {
+      fatal("undefined instruction %08x at pc=%08x", insn, pc);
+   }
+   regs[15] = pc + 4;
+}
+
+// Replace the cycle counter reads with undefined instructions so they trap
+// regardless of whether the CPU (or qemu) allows user access to the PMU
+static int patch_cycle_counter_reads() {
+   uint32_t *start = (uint32_t *) __executable_start;
+   uint32_t *end = (uint32_t *) (((uint32_t) etext + 3) & ~3);
+   long page = sysconf(_SC_PAGESIZE);
+   int count = 0;
+   uint32_t len = ((uint32_t) etext - (uint32_t) __executable_start + page - 1) & ~(page - 1);
+   if (mprotect(__executable_start, len, PROT_READ | PROT_WRITE | PROT_EXEC)) {
+      fatal("can't make text writable");
+   }
+   for (uint32_t *p = start; p < end; p++) {
+      uint32_t insn = *p;
+      if ((insn & 0x0fff0fff) == 0x0e190f1d ||     // mrc p15, 0, rt, c9, c13, 0
+          (insn & 0x0fff0fff) == 0x0e1f0f3c) {     // mrc p15, 0, rt, c15, c12, 1
+         *p = SIM_UDF_CYCLE_COUNTER | ((insn >> 28) << 8) | ((insn >> 12) & 15);
+         count++;
+      }
+   }
+   __builtin___clear_cache((char *) start, (char *) end);
+   return count;
+}
+
+// =============================================================
+// Output
+// =============================================================
+
+static void write_ppm(const char *name, uint8_t *fb, int width, int height, int pitch, int bpp) {
+   FILE *fp = fopen(name, "wb");
+   if (!fp) {
+      fatal("can't create %s", name);
+   }
+   fprintf(fp, "P6\n%d %d\n255\n", width, height);
+   for (int y = 0; y < height; y++) {
+      uint8_t *line = fb + y * pitch;
+      for (int x = 0; x < width; x++) {
+         uint8_t rgb[3];
+         if (bpp == 16) {
+            // RGBA4444, R in the low nibble
+            uint16_t p = ((uint16_t *) line)[x];
+            rgb[0] = (p & 0xf) * 17;
+            rgb[1] = ((p >> 4) & 0xf) * 17;
+            rgb[2] = ((p >> 8) & 0xf) * 17;
+         } else {
+            // no palette in the simulator, so show the palette index bits as RGB
+            int p = bpp == 8 ? line[x] : (line[x >> 1] >> ((x & 1) * 4)) & 0xf;
+            for (int c = 0; c < 3; c++) {
+               int v = ((p >> c) & 1) * 2 + ((p >> (c + 3)) & 1);
+               rgb[c] = bpp == 8 ? v * 85 : ((p >> c) & 1) * 255;
+            }
+         }
+         fwrite(rgb, 1, 3, fp);
+      }
+   }
+   fclose(fp);
+}
+
+static void write_stats(const char *name) {
+   FILE *fp = fopen(name, "w");
+   if (!fp) {
+      fatal("can't create %s", name);
+   }
+   fprintf(fp, "line,reads,counter_reads,est_insns,skipped_psync,max_latency_ns,max_read_gap_ns\n");
+   for (int i = 0; i < nlines_stream; i++) {
+      line_stats_t *s = &stats[i];
+      fprintf(fp, "%d,%u,%u,%llu,%u,%.1f,%.1f\n", i, s->reads, s->counter_reads, (unsigned long long) s->insns,
+              s->skipped, (double) s->max_latency / PS_PER_NS, (double) s->max_gap / PS_PER_NS);
+   }
+   fclose(fp);
+}
+
+// =============================================================
+// Main
+// =============================================================
+
+static void usage() {
+   fprintf(stderr,
+      "usage: capsim [options]\n"
+      "  -i file     GPIO stream to replay (run file, or raw 32 bit GPLEV0 samples)\n"
+      "  -r mhz      sample rate of a raw stream (default 100)\n"
+      "  -S l,h,n,v,c synthetic stream: line ns, hsync ns, lines, vsync lines, pixel clock Hz\n"
+      "              (default 64000,4000,312,3,16000000)\n"
+      "  -l          loop the stream\n"
+      "  -w file     save the stream as a run file\n"
+      "  -k kernel   capture_line table (default normal_3bpp)\n"
+      "  -s width    sample width 0..5 (SAMPLE_WIDTH_1 .. SAMPLE_WIDTH_12, default 1)\n"
+      "  -b bpp      frame buffer bits per pixel, 4, 8 or 16 (default 4)\n"
+      "  -c chars    characters per line (default 80)\n"
+      "  -n lines    lines to capture (default 256)\n"
+      "  -x offset   h_offset in psync clocks (default 0)\n"
+      "  -y offset   v_offset in lines (default 0)\n"
+      "  -p control  palette control (default 0)\n"
+      "  -f fields   fields to capture (default 1)\n"
+      "  -F flags    extra rgb_to_fb flags in hex\n"
+      "  -H id       hardware id 1..4 (default 3)\n"
+      "  -m mhz      ARM clock (default 1000)\n"
+      "  -g ns       cost of a peripheral access (default 25)\n"
+      "  -t ms       virtual time limit (default 2000)\n"
+      "  -o file     write the frame buffer as a PPM\n"
+      "  -d file     write the raw frame buffer\n"
+      "  -L file     write per line statistics (CSV)\n"
+      "  -v          log firmware callbacks\n");
+   exit(1);
+}
+
+int main(int argc, char **argv) {
+   capture_info_t capinfo;
+   const char *input = NULL, *save = NULL, *ppm = NULL, *raw = NULL, *csv = NULL;
+   const char *kernel = "normal_3bpp";
+   double raw_mhz = 100;
+   int synth[5] = { 64000, 4000, 312, 3, 16000000 };
+   int flags = 0;
+   int limit_ms = 2000;
+   int opt;
+
+   memset(&capinfo, 0, sizeof(capinfo));
+   capinfo.bpp = 4;
+   capinfo.chars_per_line = 80;
+   capinfo.nlines = 256;
+   capinfo.ncapture = 1;
+   capinfo.sample_width = SAMPLE_WIDTH_3;
+   capinfo.sync_type = SYNC_BIT_COMPOSITE_SYNC;
+   capinfo.detected_sync_type = SYNC_BIT_COMPOSITE_SYNC;
+   capinfo.vsync_type = VSYNC_AUTO;
+   capinfo.video_type = VIDEO_PROGRESSIVE;
+   capinfo.autoswitch = AUTOSWITCH_OFF;
+   _hardware_id = _RPI3;
+
+   while ((opt = getopt(argc, argv, "i:r:S:lw:k:s:b:c:n:x:y:p:f:F:H:m:g:t:o:d:L:v")) != -1) {
+      switch (opt) {
+      case 'i': input = optarg; break;
+      case 'r': raw_mhz = atof(optarg); break;
+      case 'S':
+         if (sscanf(optarg, "%d,%d,%d,%d,%d", &synth[0], &synth[1], &synth[2], &synth[3], &synth[4]) != 5) {
+            usage();
+         }
+         break;
+      case 'l': loop_stream = 1; break;
+      case 'w': save = optarg; break;
+      case 'k': kernel = optarg; break;
+      case 's': capinfo.sample_width = atoi(optarg); break;
+      case 'b': capinfo.bpp = atoi(optarg); break;
+      case 'c': capinfo.chars_per_line = atoi(optarg); break;
+      case 'n': capinfo.nlines = atoi(optarg); break;
+      case 'x': capinfo.h_offset = atoi(optarg); break;
+      case 'y': capinfo.v_offset = atoi(optarg); break;
+      case 'p': capinfo.palette_control = atoi(optarg); break;
+      case 'f': capinfo.ncapture = atoi(optarg); break;
+      case 'F': flags = strtol(optarg, NULL, 16); break;
+      case 'H': _hardware_id = atoi(optarg); break;
+      case 'm': cpu_mhz = atoi(optarg); break;
+      case 'g': access_ps = atoi(optarg) * PS_PER_NS; break;
+      case 't': limit_ms = atoi(optarg); break;
+      case 'o': ppm = optarg; break;
+      case 'd': raw = optarg; break;
+      case 'L': csv = optarg; break;
+      case 'v': sim_verbose = 1; break;
+      default: usage();
+      }
+   }
+   if (capinfo.sample_width < SAMPLE_WIDTH_1 || capinfo.sample_width > SAMPLE_WIDTH_12 ||
+       (capinfo.bpp != 4 && capinfo.bpp != 8 && capinfo.bpp != 16) || cpu_mhz == 0) {
+      usage();
+   }
+   for (const kernel_t *k = kernels; ; k++) {
+      if (!k->name) {
+         fatal("unknown kernel %s", kernel);
+      }
+      if (!strcmp(k->name, kernel)) {
+         capinfo.capture_line = k->table;
+         break;
+      }
+   }
+
+   if (input) {
+      load_stream(input, raw_mhz);
+   } else {
+      generate_stream(synth[0], synth[1], synth[2], synth[3], synth[4], capinfo.sample_width);
+      loop_stream = 1;
+   }
+   index_stream();
+   if (save) {
+      save_stream(save);
+   }
+
+   // Frame buffer
+   capinfo.width = capinfo.chars_per_line * 8;
+   capinfo.height = capinfo.nlines;
+   capinfo.pitch = capinfo.width * capinfo.bpp / 8;
+   capinfo.fb = calloc(4, capinfo.height * capinfo.pitch);
+   if (!capinfo.fb) {
+      fatal("out of memory");
+   }
+
+   // Peripherals
+   void *periph = mmap(NULL, SIM_PERIPHERAL_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (periph == MAP_FAILED) {
+      fatal("can't reserve peripheral block");
+   }
+   _peripheral_base = (uint32_t) periph;
+   _gplev0_base = _peripheral_base + SIM_GPLEV0;
+   _gpu_data_0 = _peripheral_base + SIM_GPU_DATA_0;
+   _gpu_command_base = _peripheral_base + SIM_GPU_COMMAND;
+
+   struct sigaction sa;
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_flags = SA_SIGINFO;
+   sa.sa_sigaction = segv_handler;
+   sigaction(SIGSEGV, &sa, NULL);
+   sa.sa_sigaction = ill_handler;
+   sigaction(SIGILL, &sa, NULL);
+
+   int patched = patch_cycle_counter_reads();
+
+   // Timing thresholds, as set by calculate_cpu_timings() and set_hsync_threshold()
+   elk_lo_field_sync_threshold = ELK_LO_FIELD_SYNC_THRESHOLD * cpu_mhz / 1000;
+   elk_hi_field_sync_threshold = ELK_HI_FIELD_SYNC_THRESHOLD * cpu_mhz / 1000;
+   odd_threshold = ODD_THRESHOLD * cpu_mhz / 1000;
+   even_threshold = EVEN_THRESHOLD * cpu_mhz / 1000;
+   frame_minimum = (int)((double)FRAME_MINIMUM * cpu_mhz / 1000);
+   frame_timeout = (int)((double)FRAME_TIMEOUT * cpu_mhz / 1000);
+   line_minimum = LINE_MINIMUM * cpu_mhz / 1000;
+   hsync_scroll = (HSYNC_SCROLL_LO * cpu_mhz / 1000) | ((HSYNC_SCROLL_HI * cpu_mhz / 1000) << 16);
+   line_timeout = LINE_TIMEOUT * cpu_mhz / 1000;
+   equalising_threshold = 100 * cpu_mhz / 1000;
+   field_type_threshold = FIELD_TYPE_THRESHOLD_BBC * cpu_mhz / 1000;
+   normal_hsync_threshold = NORMAL_HSYNC_THRESHOLD * cpu_mhz / 1000;
+   hsync_threshold = normal_hsync_threshold;
+
+   insn_ps = 1000000 / cpu_mhz;
+   vtime_limit = (uint64_t) limit_ms * 1000000000ULL;
+
+   fprintf(stderr, "capsim: %s, %d runs, %d lines, %.3f ms per pass, %d cycle counter reads patched\n",
+           input ? input : "synthetic stream", nruns, nlines_stream, (double) stream_length / 1e9, patched);
+
+   int ret = 0;
+   int last_buffer = 0;
+   if (sigsetjmp(sim_abort, 1) == 0) {
+      ret = rgb_to_fb(&capinfo, flags | BIT_CALIBRATE | BIT_NO_H_SCROLL | BIT_NO_SCANLINES);
+      last_buffer = (ret >> OFFSET_LAST_BUFFER) & 3;
+      fprintf(stderr, "capsim: rgb_to_fb returned %08x after %.3f ms\n", ret, (double) vtime / 1e9);
+   } else {
+      fprintf(stderr, "capsim: stopped (%s) after %.3f ms\n", abort_reason, (double) vtime / 1e9);
+   }
+
+   uint8_t *fb = capinfo.fb + last_buffer * capinfo.height * capinfo.pitch;
+   if (raw) {
+      FILE *fp = fopen(raw, "wb");
+      if (!fp) {
+         fatal("can't create %s", raw);
+      }
+      fwrite(fb, capinfo.pitch, capinfo.height, fp);
+      fclose(fp);
+   }
+   if (ppm) {
+      write_ppm(ppm, fb, capinfo.width, capinfo.height, capinfo.pitch, capinfo.bpp);
+   }
+   if (csv) {
+      write_stats(csv);
+   }
+   return abort_reason ? 2 : 0;
+}
@@ -0,0 +1,31 @@
+// capsim.h
+
+#ifndef CAPSIM_H
+#define CAPSIM_H
+
+// Peripheral block handed to the capture code by _get_peripheral_base
+// (every access to it faults and is emulated by the simulator)
+#define SIM_PERIPHERAL_SIZE 0x01000000
+
+// Register offsets within the peripheral block (defs.h only defines these
+// for the assembler)
+#define SIM_GPSET0        0x20001C
+#define SIM_GPCLR0        0x200028
+#define SIM_GPLEV0        0x200034
+#define SIM_GPU_COMMAND   0x0000a0
+#define SIM_GPU_DATA_0    0x0000a4
+
+// Marker used when patching cycle counter reads into undefined instructions:
+// udf #0xCCcr where c = original condition code and r = destination register
+#define SIM_UDF_MASK           0xFFFFF0F0
+#define SIM_UDF_CYCLE_COUNTER  0xE7FCC0F0
+
+extern int sim_verbose;
+
+// Set by set_vsync_psync() when the CPLD is asked to route vsync onto psync
+void sim_set_version_pin(int state);
+
+// Called by the firmware stubs to record events in the log
+void sim_log(const char *fmt, ...);
+
+#endif
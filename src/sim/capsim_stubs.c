@@ -0,0 +1,69 @@
+// capsim_stubs.c
+//
+// Stand-ins for the firmware functions called from rgb_to_fb.S and the
+// capture_line_* kernels. None of them have any effect on the capture except
+// set_vsync_psync, which controls what the simulator presents on psync.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "defs.h"
+#include "capsim.h"
+
+void swapBuffer(int buffer) {
+   sim_log("swapBuffer(%d)", buffer);
+}
+
+void DPMS(int dpms_state) {
+   sim_log("DPMS(%d)", dpms_state);
+}
+
+void reboot() {
+   fprintf(stderr, "capsim: reboot requested\n");
+   exit(3);
+}
+
+void set_ntsccolour(int value) {
+   sim_log("set_ntsccolour(%d)", value);
+}
+
+void set_timingset(int value) {
+   sim_log("set_timingset(%d)", value);
+}
+
+void set_vsync_psync(int state) {
+   sim_log("set_vsync_psync(%d)", state);
+   sim_set_version_pin(state);
+}
+
+int recalculate_hdmi_clock_line_locked_update(int force) {
+   return 0;
+}
+
+void osd_update_palette() {
+   sim_log("osd_update_palette()");
+}
+
+void osd_write_palette(int new_active) {
+   sim_log("osd_write_palette(%d)", new_active);
+}
+
+void osd_update_fast(uint32_t *osd_base, int bytes_per_line) {
+}
+
+void start_vc_bench(int type) {
+}
+
+// No DMA engine, so clears fall back to the CPU loop
+volatile uint32_t *dma_status_reg = 0;
+
+int RPI_DMA_Fill(void *dst, uint32_t value, uint32_t bytes) {
+   return 0;
+}
+
+void enable_MMU_and_IDCaches(int cached_screen_area, int cached_screen_size) {
+}
+
+void Composite_Process(Bit32u blocks, Bit8u *rgbi, int render) {
+}
@@ -0,0 +1,24 @@
+# A CMake toolchain file to build the capture simulator as an ARM Linux program
+
+# usage
+# cmake -DCMAKE_TOOLCHAIN_FILE=../toolchain-arm-linux-gnueabihf.cmake ../
+
+set( CMAKE_SYSTEM_NAME          Linux )
+set( CMAKE_SYSTEM_PROCESSOR     arm )
+
+# Set a toolchain path. You only need to set this if the toolchain isn't in
+# your system path. Don't forget a trailing path separator!
+set( TC_PATH "" )
+
+# The toolchain prefix for all toolchain executables
+set( CROSS_COMPILE arm-linux-gnueabihf- )
+
+set( CMAKE_C_COMPILER   ${TC_PATH}${CROSS_COMPILE}gcc )
+set( CMAKE_ASM_COMPILER ${TC_PATH}${CROSS_COMPILE}gcc )
+
+# The capture code is ARM (not Thumb) and assumes armv7 for the asm
+set( CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -marm -march=armv7-a -mfpu=neon-vfpv4 -mfloat-abi=hard" )
+set( CMAKE_C_FLAGS "${CMAKE_C_FLAGS}" CACHE STRING "" )
+
+set( CMAKE_ASM_FLAGS "${CMAKE_ASM_FLAGS} -marm -march=armv7-a -mfpu=neon-vfpv4 -mfloat-abi=hard" )
+set( CMAKE_ASM_FLAGS "${CMAKE_ASM_FLAGS}" CACHE STRING "" )
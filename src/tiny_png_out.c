@@ -28,25 +28,66 @@
 static const uint16_t DEFLATE_MAX_BLOCK_SIZE = 65535;
 
 static bool write  (struct TinyPngOut this[static 1], const uint8_t data[], size_t len);
+static bool flush  (struct TinyPngOut this[static 1]);
 static void crc32  (struct TinyPngOut this[static 1], const uint8_t data[], size_t len);
 static void adler32(struct TinyPngOut this[static 1], const uint8_t data[], size_t len);
 static void putBigUint32(uint32_t val, uint8_t array[static 4]);
+static enum TinyPngOut_Status start(struct TinyPngOut this[static 1], uint32_t w, uint32_t h,
+	const uint32_t *palette, int paletteSize);
+static enum TinyPngOut_Status writeCompressed(struct TinyPngOut this[static 1], const uint8_t pixels[], size_t count);
+static bool deflateFeed  (struct TinyPngOut this[static 1], const uint8_t data[], size_t len);
+static bool deflateFinish(struct TinyPngOut this[static 1]);
+static bool deflateStep  (struct TinyPngOut this[static 1]);
+static bool putBits      (struct TinyPngOut this[static 1], uint32_t value, uint32_t n);
+static bool emitIdat     (struct TinyPngOut this[static 1]);
 
 
 enum TinyPngOut_Status TinyPngOut_init(struct TinyPngOut this[static 1], uint32_t w, uint32_t h, uint8_t *out) {
+	if (out == NULL)
+		return TINYPNGOUT_INVALID_ARGUMENT;
+	this->output = out;
+	this->sink = NULL;
+	this->sinkContext = NULL;
+	this->blockSize = 0;
+	this->deflate = NULL;
+	return start(this, w, h, NULL, 0);
+}
+
+
+enum TinyPngOut_Status TinyPngOut_init_stream(struct TinyPngOut this[static 1], uint32_t w, uint32_t h,
+		const uint32_t *palette, int paletteSize, uint8_t *block, uint32_t blockSize, TinyPngOut_Sink sink, void *context,
+		struct TinyPngOut_Deflate *deflate) {
+	if (block == NULL || blockSize == 0 || sink == NULL)
+		return TINYPNGOUT_INVALID_ARGUMENT;
+	if (deflate != NULL && blockSize < 3 * 256 + 24)
+		return TINYPNGOUT_INVALID_ARGUMENT;  // Must hold the PLTE chunk and leave room for IDAT data
+	if (palette != NULL && (paletteSize < 1 || paletteSize > 256))
+		return TINYPNGOUT_INVALID_ARGUMENT;
+	this->output = block;
+	this->sink = sink;
+	this->sinkContext = context;
+	this->blockSize = blockSize;
+	this->deflate = deflate;
+	return start(this, w, h, palette, paletteSize);
+}
+
+
+static enum TinyPngOut_Status start(struct TinyPngOut this[static 1], uint32_t w, uint32_t h,
+		const uint32_t *palette, int paletteSize) {
 	// Check arguments
-	if (w == 0 || h == 0 || out == NULL)
+	if (w == 0 || h == 0)
 		return TINYPNGOUT_INVALID_ARGUMENT;
 	this->width = w;
 	this->height = h;
+	this->bytesPerPixel = palette != NULL ? 1 : 3;
 
 	// Compute and check data siezs
-	uint64_t lineSz = (uint64_t)this->width * 3 + 1;
+	uint64_t lineSz = (uint64_t)this->width * this->bytesPerPixel + 1;
 	if (lineSz > UINT32_MAX)
 		return TINYPNGOUT_IMAGE_TOO_LARGE;
 	this->lineSize = (uint32_t)lineSz;
 
-	uint64_t uncompRm = this->lineSize * this->height;
+	uint64_t uncompRm = (uint64_t)this->lineSize * this->height;
 	if (uncompRm > UINT32_MAX)
 		return TINYPNGOUT_IMAGE_TOO_LARGE;
 	this->uncompRemain = (uint32_t)uncompRm;
@@ -60,8 +101,10 @@ enum TinyPngOut_Status TinyPngOut_init(struct TinyPngOut this[static 1], uint32_
 	if (idatSize > (uint32_t)INT32_MAX)
 		return TINYPNGOUT_IMAGE_TOO_LARGE;
 
-	// Write header (not a pure header, but a couple of things concatenated together)
-	uint8_t header[] = {  // 43 bytes long
+	this->output_len = 0;
+
+	// Write header
+	uint8_t header[] = {  // 33 bytes long
 		// PNG header
 		0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A,
 		// IHDR chunk
@@ -71,30 +114,69 @@ enum TinyPngOut_Status TinyPngOut_init(struct TinyPngOut this[static 1], uint32_
 		0, 0, 0, 0,  // 'height' placeholder
 		0x08, 0x02, 0x00, 0x00, 0x00,
 		0, 0, 0, 0,  // IHDR CRC-32 placeholder
-		// IDAT chunk
-		0, 0, 0, 0,  // 'idatSize' placeholder
-		0x49, 0x44, 0x41, 0x54,
-		// DEFLATE data
-		0x08, 0x1D,
 	};
 	putBigUint32(this->width, &header[16]);
 	putBigUint32(this->height, &header[20]);
-	putBigUint32(idatSize, &header[33]);
+	if (palette != NULL)
+		header[25] = 0x03;  // Indexed colour
 	this->crc = 0;
 	crc32(this, &header[12], 17);
 	putBigUint32(this->crc, &header[29]);
-	this->output = out;
-	this->output_len = 0;
 	if (!write(this, header, sizeof(header) / sizeof(header[0])))
 		return TINYPNGOUT_IO_ERROR;
 
-	this->crc = 0;
-	crc32(this, &header[37], 6);  // 0xD7245B6B
-	this->adler = 1;
+	if (palette != NULL) {
+		uint8_t plte[8 + 3 * 256 + 4];
+		uint32_t len = 3 * paletteSize;
+		putBigUint32(len, &plte[0]);
+		memcpy(&plte[4], "PLTE", 4);
+		for (int i = 0; i < paletteSize; i++) {
+			plte[8 + i * 3 + 0] = (uint8_t)(palette[i] >> 0);
+			plte[8 + i * 3 + 1] = (uint8_t)(palette[i] >> 8);
+			plte[8 + i * 3 + 2] = (uint8_t)(palette[i] >> 16);
+		}
+		this->crc = 0;
+		crc32(this, &plte[4], len + 4);
+		putBigUint32(this->crc, &plte[8 + len]);
+		if (!write(this, plte, len + 12))
+			return TINYPNGOUT_IO_ERROR;
+	}
 
 	this->positionX = 0;
 	this->positionY = 0;
 	this->deflateFilled = 0;
+	this->adler = 1;
+
+	if (this->deflate != NULL) {
+		// IDAT chunks are built in the output buffer from here on
+		if (!flush(this))
+			return TINYPNGOUT_IO_ERROR;
+		struct TinyPngOut_Deflate *d = this->deflate;
+		memset(d->head, 0xFF, sizeof(d->head));
+		d->strStart = 0;
+		d->winEnd = 0;
+		d->bitBuf = 0;
+		d->bitCount = 0;
+		this->idatLen = 0;
+		// zlib header (32K window), then the single final block using the fixed Huffman codes
+		if (!putBits(this, 0x78, 8) || !putBits(this, 0x01, 8) || !putBits(this, 1, 1) || !putBits(this, 1, 2))
+			return TINYPNGOUT_IO_ERROR;
+		return TINYPNGOUT_OK;
+	}
+
+	uint8_t idat[] = {  // 10 bytes long
+		// IDAT chunk
+		0, 0, 0, 0,  // 'idatSize' placeholder
+		0x49, 0x44, 0x41, 0x54,
+		// DEFLATE data
+		0x08, 0x1D,
+	};
+	putBigUint32(idatSize, &idat[0]);
+	if (!write(this, idat, sizeof(idat) / sizeof(idat[0])))
+		return TINYPNGOUT_IO_ERROR;
+
+	this->crc = 0;
+	crc32(this, &idat[4], 6);  // 0xD7245B6B
 	return TINYPNGOUT_OK;
 }
 
@@ -102,7 +184,9 @@ enum TinyPngOut_Status TinyPngOut_init(struct TinyPngOut this[static 1], uint32_
 enum TinyPngOut_Status TinyPngOut_write(struct TinyPngOut this[static 1], const uint8_t pixels[], size_t count) {
 	if (count > SIZE_MAX / 3)
 		return TINYPNGOUT_INVALID_ARGUMENT;
-	count *= 3;  // Convert pixel count to byte count
+	if (this->deflate != NULL)
+		return writeCompressed(this, pixels, count);
+	count *= this->bytesPerPixel;  // Convert pixel count to byte count
 	while (count > 0) {
 		if (pixels == NULL)
 			return TINYPNGOUT_INVALID_ARGUMENT;
@@ -178,6 +262,8 @@ enum TinyPngOut_Status TinyPngOut_write(struct TinyPngOut this[static 1], const
 				putBigUint32(this->crc, &footer[4]);
 				if (!write(this, footer, sizeof(footer) / sizeof(footer[0])))
 					return TINYPNGOUT_IO_ERROR;
+				if (!flush(this))
+					return TINYPNGOUT_IO_ERROR;
 			}
 		}
 	}
@@ -188,24 +274,283 @@ enum TinyPngOut_Status TinyPngOut_write(struct TinyPngOut this[static 1], const
 
 /*---- Private utility functions ----*/
 
+/*---- Compressed output ----*/
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+
+static uint32_t reverseBits(uint32_t code, int len) {
+	uint32_t result = 0;
+	for (int i = 0; i < len; i++, code >>= 1)
+		result = (result << 1) | (code & 1);
+	return result;
+}
+
+
+// Writes a literal/length symbol using the fixed Huffman code (RFC 1951 3.2.6).
+static bool putSymbol(struct TinyPngOut this[static 1], int sym) {
+	if (sym < 144)
+		return putBits(this, reverseBits(0x30 + sym, 8), 8);
+	else if (sym < 256)
+		return putBits(this, reverseBits(0x190 + sym - 144, 9), 9);
+	else if (sym < 280)
+		return putBits(this, reverseBits(sym - 256, 7), 7);
+	else
+		return putBits(this, reverseBits(0xC0 + sym - 280, 8), 8);
+}
+
+
+static bool putMatch(struct TinyPngOut this[static 1], int len, int dist) {
+	int i = 28;
+	while (LENGTH_BASE[i] > len)
+		i--;
+	if (!putSymbol(this, 257 + i) || !putBits(this, len - LENGTH_BASE[i], LENGTH_EXTRA[i]))
+		return false;
+	i = 29;
+	while (DIST_BASE[i] > dist)
+		i--;
+	return putBits(this, reverseBits(i, 5), 5) && putBits(this, dist - DIST_BASE[i], DIST_EXTRA[i]);
+}
+
+
+static enum TinyPngOut_Status writeCompressed(struct TinyPngOut this[static 1], const uint8_t pixels[], size_t count) {
+	count *= this->bytesPerPixel;  // Convert pixel count to byte count
+	while (count > 0) {
+		if (pixels == NULL)
+			return TINYPNGOUT_INVALID_ARGUMENT;
+		if (this->positionY >= this->height)
+			return TINYPNGOUT_INVALID_ARGUMENT;  // All image pixels already written
+
+		if (this->positionX == 0) {  // Beginning of line - filter method byte
+			uint8_t b[] = {0};
+			if (!deflateFeed(this, b, 1))
+				return TINYPNGOUT_IO_ERROR;
+			adler32(this, b, 1);
+			this->positionX++;
+		}
+		size_t n = this->lineSize - this->positionX;
+		if (count < n)
+			n = count;
+		if (!deflateFeed(this, pixels, n))
+			return TINYPNGOUT_IO_ERROR;
+		adler32(this, pixels, n);
+		count -= n;
+		pixels += n;
+		this->positionX += n;
+
+		if (this->positionX == this->lineSize) {  // Increment line
+			this->positionX = 0;
+			this->positionY++;
+			if (this->positionY == this->height) {  // Reached end of pixels
+				if (!deflateFinish(this))
+					return TINYPNGOUT_IO_ERROR;
+			}
+		}
+	}
+	return TINYPNGOUT_OK;
+}
+
+
+// Appends uncompressed data to the window, compressing whatever has enough lookahead.
+static bool deflateFeed(struct TinyPngOut this[static 1], const uint8_t data[], size_t len) {
+	struct TinyPngOut_Deflate *d = this->deflate;
+	while (len > 0) {
+		if (d->winEnd == 2 * TINYPNGOUT_WINDOW_SIZE) {
+			// Slide the window down, the compressor always leaves less than MAX_MATCH bytes of lookahead
+			memmove(d->window, d->window + TINYPNGOUT_WINDOW_SIZE, TINYPNGOUT_WINDOW_SIZE);
+			d->strStart -= TINYPNGOUT_WINDOW_SIZE;
+			d->winEnd -= TINYPNGOUT_WINDOW_SIZE;
+			for (int i = 0; i < (1 << TINYPNGOUT_HASH_BITS); i++)
+				d->head[i] = d->head[i] >= TINYPNGOUT_WINDOW_SIZE ? d->head[i] - TINYPNGOUT_WINDOW_SIZE : -1;
+		}
+		size_t n = 2 * TINYPNGOUT_WINDOW_SIZE - d->winEnd;
+		if (len < n)
+			n = len;
+		memcpy(d->window + d->winEnd, data, n);
+		d->winEnd += n;
+		data += n;
+		len -= n;
+		while (d->winEnd - d->strStart >= MAX_MATCH) {
+			if (!deflateStep(this))
+				return false;
+		}
+	}
+	return true;
+}
+
+
+static int matchLength(const uint8_t *a, const uint8_t *b, int max) {
+	int len = 0;
+	while (len < max && a[len] == b[len])
+		len++;
+	return len;
+}
+
+
+// Compresses the next literal or match at strStart.
+static bool deflateStep(struct TinyPngOut this[static 1]) {
+	struct TinyPngOut_Deflate *d = this->deflate;
+	int32_t pos = d->strStart;
+	int max = d->winEnd - pos;
+	if (max > MAX_MATCH)
+		max = MAX_MATCH;
+	const uint8_t *cur = d->window + pos;
+	int bestLen = 0;
+	int bestDist = 0;
+
+	if (max >= MIN_MATCH) {
+		// Runs of one colour are by far the most common, then repeats of the line above
+		if (pos >= 1) {
+			bestLen = matchLength(cur, cur - 1, max);
+			bestDist = 1;
+		}
+		int32_t up = (int32_t)this->lineSize;
+		if (bestLen < max && up <= TINYPNGOUT_WINDOW_SIZE && pos >= up) {
+			int len = matchLength(cur, cur - up, max);
+			if (len > bestLen) {
+				bestLen = len;
+				bestDist = up;
+			}
+		}
+		uint32_t h = ((cur[0] << 10) ^ (cur[1] << 5) ^ cur[2]) & ((1 << TINYPNGOUT_HASH_BITS) - 1);
+		int32_t cand = d->head[h];
+		d->head[h] = pos;
+		if (bestLen < max && cand >= 0 && pos - cand <= TINYPNGOUT_WINDOW_SIZE) {
+			int len = matchLength(cur, d->window + cand, max);
+			if (len > bestLen) {
+				bestLen = len;
+				bestDist = pos - cand;
+			}
+		}
+	}
+
+	if (bestLen >= MIN_MATCH) {
+		d->strStart += bestLen;
+		return putMatch(this, bestLen, bestDist);
+	}
+	d->strStart++;
+	return putSymbol(this, cur[0]);
+}
+
+
+// Compresses the remaining lookahead and ends the zlib stream, IDAT and file.
+static bool deflateFinish(struct TinyPngOut this[static 1]) {
+	struct TinyPngOut_Deflate *d = this->deflate;
+	while (d->strStart < d->winEnd) {
+		if (!deflateStep(this))
+			return false;
+	}
+	if (!putSymbol(this, 256))  // End of block
+		return false;
+	if (d->bitCount > 0 && !putBits(this, 0, 8 - d->bitCount))
+		return false;
+	for (int i = 3; i >= 0; i--) {
+		if (!putBits(this, (this->adler >> (i * 8)) & 0xFF, 8))
+			return false;
+	}
+	if (!emitIdat(this))
+		return false;
+	const uint8_t iend[] = {  // 12 bytes long
+		0x00, 0x00, 0x00, 0x00,
+		0x49, 0x45, 0x4E, 0x44,
+		0xAE, 0x42, 0x60, 0x82,
+	};
+	return this->sink(this->sinkContext, iend, sizeof(iend));
+}
+
+
+// Adds bits to the output, least significant first, completing IDAT chunks as the buffer fills.
+static bool putBits(struct TinyPngOut this[static 1], uint32_t value, uint32_t n) {
+	struct TinyPngOut_Deflate *d = this->deflate;
+	d->bitBuf |= value << d->bitCount;
+	d->bitCount += n;
+	while (d->bitCount >= 8) {
+		this->output[8 + this->idatLen++] = (uint8_t)d->bitBuf;
+		d->bitBuf >>= 8;
+		d->bitCount -= 8;
+		if (this->idatLen == this->blockSize - 12 && !emitIdat(this))
+			return false;
+	}
+	return true;
+}
+
+
+// Wraps the compressed bytes in the output buffer (which start 8 bytes in) as an IDAT chunk.
+static bool emitIdat(struct TinyPngOut this[static 1]) {
+	if (this->idatLen == 0)
+		return true;
+	putBigUint32(this->idatLen, &this->output[0]);
+	memcpy(&this->output[4], "IDAT", 4);
+	this->crc = 0;
+	crc32(this, &this->output[4], this->idatLen + 4);
+	putBigUint32(this->crc, &this->output[8 + this->idatLen]);
+	bool ok = this->sink(this->sinkContext, this->output, this->idatLen + 12);
+	this->idatLen = 0;
+	return ok;
+}
+
+
+/*---- Private helper functions ----*/
+
 // Returns whether the write was successful.
 static bool write(struct TinyPngOut this[static 1], const uint8_t data[], size_t len) {
-   memcpy(this->output + this->output_len, data, len);
-   this->output_len += len;
-	return 1;
+	if (this->sink == NULL) {
+		memcpy(this->output + this->output_len, data, len);
+		this->output_len += len;
+		return true;
+	}
+	while (len > 0) {
+		size_t n = this->blockSize - this->output_len;
+		if (len < n)
+			n = len;
+		memcpy(this->output + this->output_len, data, n);
+		this->output_len += n;
+		data += n;
+		len -= n;
+		if (this->output_len == this->blockSize && !flush(this))
+			return false;
+	}
+	return true;
+}
+
+
+// Hands any buffered output to the sink in streaming mode.
+static bool flush(struct TinyPngOut this[static 1]) {
+	if (this->sink == NULL || this->output_len == 0)
+		return true;
+	bool ok = this->sink(this->sinkContext, this->output, this->output_len);
+	this->output_len = 0;
+	return ok;
 }
 
 
 // Reads the 'crc' field and updates its value based on the given array of new data.
 static void crc32(struct TinyPngOut this[static 1], const uint8_t data[], size_t len) {
-	this->crc = ~this->crc;
-	for (size_t i = 0; i < len; i++) {
-		for (int j = 0; j < 8; j++) {  // Inefficient bitwise implementation, instead of table-based
-			uint32_t bit = (this->crc ^ (data[i] >> j)) & 1;
-			this->crc = (this->crc >> 1) ^ ((-bit) & UINT32_C(0xEDB88320));
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if (!tableReady) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c >> 1) ^ ((-(c & 1)) & UINT32_C(0xEDB88320));
+			table[i] = c;
 		}
+		tableReady = true;
 	}
-	this->crc = ~this->crc;
+	uint32_t crc = ~this->crc;
+	for (size_t i = 0; i < len; i++)
+		crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+	this->crc = ~crc;
 }
 
 
@@ -213,9 +558,16 @@ static void crc32(struct TinyPngOut this[static 1], const uint8_t data[], size_t
 static void adler32(struct TinyPngOut this[static 1], const uint8_t data[], size_t len) {
 	uint32_t s1 = this->adler & 0xFFFF;
 	uint32_t s2 = this->adler >> 16;
-	for (size_t i = 0; i < len; i++) {
-		s1 = (s1 + data[i]) % 65521;
-		s2 = (s2 + s1) % 65521;
+	while (len > 0) {
+		size_t n = len < 5552 ? len : 5552;  // Largest run that can't overflow s2 before the modulo
+		len -= n;
+		for (size_t i = 0; i < n; i++) {
+			s1 += data[i];
+			s2 += s1;
+		}
+		data += n;
+		s1 %= 65521;
+		s2 %= 65521;
 	}
 	this->adler = s2 << 16 | s1;
 }
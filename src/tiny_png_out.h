@@ -21,10 +21,31 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 
+// Receives each full output block (and the final partial one) in streaming mode.
+// Returns whether the data was written.
+typedef bool (*TinyPngOut_Sink)(void *context, const uint8_t data[], size_t len);
+
+
+#define TINYPNGOUT_WINDOW_SIZE 32768
+#define TINYPNGOUT_HASH_BITS   14
+
+// Working storage for the compressing encoder (about 192KB, so normally static).
+// Treat this data structure as private and opaque.
+struct TinyPngOut_Deflate {
+	uint8_t window[2 * TINYPNGOUT_WINDOW_SIZE];  // Uncompressed history followed by lookahead
+	int32_t head[1 << TINYPNGOUT_HASH_BITS];      // Most recent window position for each 3 byte hash, -1 if none
+	int32_t strStart;   // Next window position to be compressed
+	int32_t winEnd;     // End of the data in the window
+	uint32_t bitBuf;    // Pending output bits, least significant first
+	uint32_t bitCount;
+};
+
+
 // Treat this data structure as private and opaque. Do not read or write any fields directly.
 // This structure can be safely discarded at any time, because the functions of this library don't
 // allocate memory or resources. The caller is responsible for initializing objects and cleaning up.
@@ -33,7 +54,12 @@ struct TinyPngOut {
 	// Immutable configuration
 	uint32_t width;   // Measured in pixels
 	uint32_t height;  // Measured in pixels
-	uint32_t lineSize;  // Measured in bytes, equal to (width * 3 + 1)
+	uint32_t lineSize;  // Measured in bytes, equal to (width * bytesPerPixel + 1)
+	uint32_t bytesPerPixel;  // 3 for RGB, 1 for palette indices
+	TinyPngOut_Sink sink;    // NULL when writing the whole file to the output buffer
+	void *sinkContext;
+	uint32_t blockSize;      // Size of the output buffer in streaming mode
+	struct TinyPngOut_Deflate *deflate;  // NULL for stored (uncompressed) DEFLATE blocks
 
 	// Running state
 	uint8_t *output;
@@ -44,6 +70,7 @@ struct TinyPngOut {
 	uint16_t deflateFilled;  // Bytes filled in the current block (0 <= n < DEFLATE_MAX_BLOCK_SIZE)
 	uint32_t crc;    // Primarily for IDAT chunk
 	uint32_t adler;  // For DEFLATE data within IDAT
+	uint32_t idatLen;  // Compressed bytes waiting in the output buffer for the current IDAT chunk
 
 };
 
@@ -64,10 +91,23 @@ enum TinyPngOut_Status {
 enum TinyPngOut_Status TinyPngOut_init(struct TinyPngOut this[static 1], uint32_t w, uint32_t h, uint8_t *output_buffer);
 
 
+/*
+ * Creates a streaming PNG writer. Output is assembled in 'block' and handed to 'sink' each time
+ * 'blockSize' bytes are ready, so only the block needs to be held in memory. If 'palette' is not
+ * NULL the image is 8 bit indexed colour with 'paletteSize' entries (each 0x00BBGGRR) and each
+ * pixel is one byte, otherwise each pixel is three bytes of RGB.
+ * If 'deflate' is not NULL the image data is compressed (single pass LZ77 favouring runs and
+ * repeats of the line above, fixed Huffman codes) and each block becomes one IDAT chunk.
+ */
+enum TinyPngOut_Status TinyPngOut_init_stream(struct TinyPngOut this[static 1], uint32_t w, uint32_t h,
+	const uint32_t *palette, int paletteSize, uint8_t *block, uint32_t blockSize, TinyPngOut_Sink sink, void *context,
+	struct TinyPngOut_Deflate *deflate);
+
+
 /*
  * Writes 'count' pixels from the given array to the output stream. This reads count*3
- * bytes from the array. Pixels are presented from top to bottom, left to right, and with
- * subpixels in RGB order. This object keeps track of how many pixels were written and
+ * bytes (count bytes for a palette image) from the array. Pixels are presented from top to
+ * bottom, left to right, and with subpixels in RGB order. This object keeps track of how many pixels were written and
  * various position variables. It is an error to write more pixels in total than width*height.
  * Once exactly width*height pixels have been written with this TinyPngOut object,
  * there are no more valid operations on the object and it should be discarded.
@@ -37,6 +37,7 @@
 
 .equ COMMAND_MASK,         0x00000fff     #masks out command bits that trigger sync detection
 #command bits
+.equ LINE_TAG_FLAG,        12             #line buffer mode: psync bit value for this line
 .equ OLD_FIRMWARE_FLAG,    13
 .equ HIGH_LATENCY_FLAG,    14
 .equ SIMPLE_SYNC_FLAG,     15
@@ -163,6 +164,7 @@ write_bench_loop:
    rts
 
 not_mbox_write_benchmark:
+   mov    r13, r1                      #line buffer bus address or zero to use the mailbox registers
    mov    r4, GPLEV0
    mov    r5, GPU_COMMAND
    mov    r6, VIDEO_MASK
@@ -307,6 +309,8 @@ wait_csync_hi_cpld:
    beq    wait_csync_hi_cpld
 
 capture_rest:
+   cmp    r13, 0
+   bne    mem_capture
    btst   r3, HIGH_LATENCY_FLAG         #bit signals high latency capture, only suitable for 9/12bpp modes
    bne    hl_capture
 
@@ -399,6 +403,8 @@ ofw_wait_csync_hi_cpld:
    beq    ofw_wait_csync_hi_cpld
 
 ofw_capture_rest:
+   cmp    r13, 0
+   bne    mem_ofw_capture
    and    r3, r7         #mask off any command bits (max capture is 4095 psync cycles)
    add    r3, 1          #round up to multiple of 2
    lsr    r3, 1          #divide by 2 as capturing 2 samples per cycle
@@ -495,3 +501,46 @@ high_latency_capture_loop:
 
    b      wait_for_command
 
+# line buffer mode, samples are written sequentially to SDRAM so the ARM never
+# has to keep up with a 6 word window. Every word carries the line tag in the psync
+# bit and a word with the final bit set follows the last one (high latency is not
+# needed as the ARM is not reading peripheral registers)
+
+mem_capture:
+   mov    r2, r8           #psync bit is the line tag instead of toggling every 6 words
+   btst   r3, LINE_TAG_FLAG
+   bclreq r2, PSYNC_BIT
+   and    r3, r7           #mask off any command bits (max capture is 4095 psync cycles)
+   add    r3, 1            #round up to multiple of 2
+   lsr    r3, 1            #divide by 2 as capturing 2 samples per cycle
+   mov    r11, r13
+
+mem_capture_loop:
+   LO_PSYNC_CAPTURE
+   HI_PSYNC_CAPTURE
+   st     r0, (r11)
+   add    r11, 4
+   bne    mem_capture_loop
+
+mem_capture_done:
+   mov    r0, r2
+   bset   r0, FINAL_BIT
+   st     r0, (r11)        #terminating word
+   b      wait_for_command
+
+mem_ofw_capture:
+   mov    r2, r8
+   btst   r3, LINE_TAG_FLAG
+   bclreq r2, PSYNC_BIT
+   and    r3, r7
+   add    r3, 1
+   lsr    r3, 1
+   mov    r11, r13
+
+mem_ofw_capture_loop:
+   OFW_LO_PSYNC_CAPTURE
+   OFW_HI_PSYNC_CAPTURE
+   st     r0, (r11)
+   add    r11, 4
+   bne    mem_ofw_capture_loop
+   b      mem_capture_done